@@ -0,0 +1,426 @@
+#include "ofMain.h"
+#include "ofAppNoWindow.h"
+
+#include "ofxPhysX.h"
+
+// Headless benchmark: runs each scene for every thread count and timestep and
+// writes one row of timings per run.
+//
+//   benchmark [--scenes swarm_1k,box_stack] [--threads 0,1,2,4] [--timesteps 0.016,0.008]
+//             [--steps 300] [--warmup 30] [--out results.csv|results.json]
+
+class Scene
+{
+public:
+	
+	virtual ~Scene() {}
+	
+	virtual ofVec3f getGravity() const { return ofVec3f(0, -980, 0); }
+	virtual void setup(ofxPhysX::World& world) = 0;
+	virtual void update(ofxPhysX::World& world) {}
+	virtual int getNumBodies() const = 0;
+	
+	// timed only once most bodies came to rest on the ground
+	virtual bool settles() const { return false; }
+};
+
+// spheres pulled into a ball by an attractor, dense and contact heavy
+class SwarmScene : public Scene
+{
+public:
+	
+	SwarmScene(int n) : n(n) {}
+	
+	ofVec3f getGravity() const { return ofVec3f(0, 0, 0); }
+	
+	void setup(ofxPhysX::World& world)
+	{
+		const float r = 30 * cbrtf(n / 300.);
+		
+		vector<ofVec3f> positions(n);
+		for (int i = 0; i < n; i++)
+			positions[i].set(ofRandom(-r, r), ofRandom(-r, r), ofRandom(-r, r));
+		
+		world.addSpheres(vector<float>(1, 4), positions);
+		world.addForceField(ofxPhysX::ForceField::attractor(ofVec3f(0, 0, 0), 2000));
+	}
+	
+	int getNumBodies() const { return n; }
+	
+protected:
+	
+	int n;
+};
+
+// towers of boxes resting on a plane, mostly sleeping islands
+class BoxStackScene : public Scene
+{
+public:
+	
+	BoxStackScene(int towers, int height) : towers(towers), height(height) {}
+	
+	void setup(ofxPhysX::World& world)
+	{
+		world.addPlane(ofVec3f(0, 0, 0));
+		
+		const float size = 10;
+		const float spacing = size * 3;
+		
+		vector<ofVec3f> positions;
+		for (int x = 0; x < towers; x++)
+		{
+			for (int z = 0; z < towers; z++)
+			{
+				for (int y = 0; y < height; y++)
+				{
+					ofVec3f p((x - towers / 2) * spacing, size * (y + 0.5), (z - towers / 2) * spacing);
+					positions.push_back(p);
+				}
+			}
+		}
+		
+		world.addBoxes(vector<ofVec3f>(1, ofVec3f(size, size, size)), positions);
+	}
+	
+	int getNumBodies() const { return towers * towers * height; }
+	bool settles() const { return true; }
+	
+protected:
+	
+	int towers, height;
+};
+
+// capsules dropped onto a plane in random orientations
+class CapsulePileScene : public Scene
+{
+public:
+	
+	CapsulePileScene(int n) : n(n) {}
+	
+	void setup(ofxPhysX::World& world)
+	{
+		world.addPlane(ofVec3f(0, 0, 0));
+		
+		const float r = 10 * sqrtf(n);
+		
+		vector<ofVec3f> positions(n);
+		vector<ofQuaternion> rotations(n);
+		for (int i = 0; i < n; i++)
+		{
+			positions[i].set(ofRandom(-r, r), ofRandom(20, 20 + r), ofRandom(-r, r));
+			rotations[i].makeRotate(ofRandom(360), ofVec3f(ofRandomf(), ofRandomf(), ofRandomf()).normalize());
+		}
+		
+		world.addCapsules(vector<float>(1, 3), vector<float>(1, 10), positions, rotations);
+	}
+	
+	int getNumBodies() const { return n; }
+	bool settles() const { return true; }
+	
+protected:
+	
+	int n;
+};
+
+// steady population where the oldest bodies are replaced every step
+class SpawnScene : public Scene
+{
+public:
+	
+	SpawnScene(int n, int perStep) : n(n), perStep(perStep) {}
+	
+	void setup(ofxPhysX::World& world)
+	{
+		world.addPlane(ofVec3f(0, 0, 0));
+		spawn(world, n);
+	}
+	
+	void update(ofxPhysX::World& world)
+	{
+		for (int i = 0; i < perStep && !alive.empty(); i++)
+		{
+			world.removeActor(alive.front());
+			alive.pop_front();
+		}
+		
+		spawn(world, perStep);
+	}
+	
+	int getNumBodies() const { return n; }
+	
+protected:
+	
+	void spawn(ofxPhysX::World& world, int count)
+	{
+		const float r = 10 * sqrtf(n);
+		
+		vector<ofVec3f> positions(count);
+		for (int i = 0; i < count; i++)
+			positions[i].set(ofRandom(-r, r), ofRandom(20, 200), ofRandom(-r, r));
+		
+		vector<physx::PxActor*> actors = world.addSpheres(vector<float>(1, 4), positions);
+		alive.insert(alive.end(), actors.begin(), actors.end());
+	}
+	
+	int n, perStep;
+	deque<physx::PxActor*> alive;
+};
+
+static Scene* createScene(const string& name)
+{
+	if (name == "swarm_1k") return new SwarmScene(1000);
+	if (name == "swarm_10k") return new SwarmScene(10000);
+	if (name == "swarm_50k") return new SwarmScene(50000);
+	if (name == "box_stack") return new BoxStackScene(10, 10);
+	if (name == "capsule_pile") return new CapsulePileScene(2000);
+	if (name == "spawn_despawn") return new SpawnScene(2000, 100);
+	return NULL;
+}
+
+struct Options
+{
+	Options() : steps(300), warmup(30), output("benchmark.csv")
+	{
+		scenes = ofSplitString("swarm_1k,swarm_10k,swarm_50k,box_stack,capsule_pile,spawn_despawn", ",");
+		
+		threads.push_back(0);
+		threads.push_back(1);
+		threads.push_back(2);
+		threads.push_back(4);
+		
+		timesteps.push_back(1. / 60.);
+	}
+	
+	vector<string> scenes;
+	vector<int> threads;
+	vector<float> timesteps;
+	int steps;
+	int warmup;
+	string output;
+};
+
+struct Result
+{
+	string scene;
+	int bodies;
+	int threads;
+	float timestep;
+	int steps;
+	
+	float stepMin, stepMean, stepP99, stepMax;
+	float simulateMean, fetchMean, forceFieldsMean;
+	ofxPhysX::WorldStats::Counts counts;
+};
+
+static Options options;
+
+class ofApp : public ofBaseApp
+{
+public:
+	void setup()
+	{
+		vector<Result> results;
+		
+		for (size_t i = 0; i < options.scenes.size(); i++)
+		{
+			for (size_t j = 0; j < options.threads.size(); j++)
+			{
+				for (size_t k = 0; k < options.timesteps.size(); k++)
+				{
+					Result r;
+					if (run(options.scenes[i], options.threads[j], options.timesteps[k], r))
+					{
+						results.push_back(r);
+						print(r);
+					}
+				}
+			}
+		}
+		
+		save(results, options.output);
+		
+		ofExit(results.empty() ? 1 : 0);
+	}
+	
+	bool run(const string& name, int threads, float dt, Result& r)
+	{
+		Scene *scene = createScene(name);
+		if (!scene)
+		{
+			ofLogError("benchmark") << "unknown scene " << name;
+			return false;
+		}
+		
+		// same bodies for every configuration of a scene
+		ofSeedRandom(0);
+		
+		ofxPhysX::TaskSchedulerSettings settings;
+		settings.numThreads = threads;
+		
+		ofxPhysX::World *world = new ofxPhysX::World;
+		world->setDebugDrawEnabled(false);
+		world->setup(scene->getGravity(), settings);
+		world->getStats().setWindow(options.steps);
+		
+		scene->setup(*world);
+		
+		for (int i = 0; i < options.warmup; i++)
+		{
+			scene->update(*world);
+			world->step(dt);
+		}
+		
+		if (scene->settles() && !settle(*scene, *world, dt))
+			ofLogWarning("benchmark") << name << " didn't come to rest, timing bodies still in motion";
+		
+		world->getStats().clear();
+		
+		ofxPhysX::TimingSeries stepTimes(options.steps);
+		
+		for (int i = 0; i < options.steps; i++)
+		{
+			scene->update(*world);
+			
+			unsigned long long t = ofGetElapsedTimeMicros();
+			world->step(dt);
+			stepTimes.add((ofGetElapsedTimeMicros() - t) / 1000.);
+		}
+		
+		const ofxPhysX::WorldStats& stats = world->getStats();
+		
+		r.scene = name;
+		r.bodies = scene->getNumBodies();
+		r.threads = threads;
+		r.timestep = dt;
+		r.steps = options.steps;
+		r.stepMin = stepTimes.getMin();
+		r.stepMean = stepTimes.getMean();
+		r.stepP99 = stepTimes.getP99();
+		r.stepMax = stepTimes.getMax();
+		r.simulateMean = stats.get(ofxPhysX::WorldStats::SIMULATE).getMean();
+		r.fetchMean = stats.get(ofxPhysX::WorldStats::FETCH).getMean();
+		r.forceFieldsMean = stats.get(ofxPhysX::WorldStats::FORCE_FIELDS).getMean();
+		r.counts = stats.getCounts();
+		
+		delete world;
+		delete scene;
+		
+		return true;
+	}
+	
+	// step until at most 1% of the bodies are awake, for up to a minute of simulated time
+	bool settle(Scene& scene, ofxPhysX::World& world, float dt)
+	{
+		const int maxSteps = 60 / dt;
+		
+		for (int i = 0; i < maxSteps; i++)
+		{
+			const ofxPhysX::WorldStats::Counts& counts = world.getStats().getCounts();
+			if (counts.dynamicBodies > 0 && counts.activeDynamicBodies * 100 <= counts.dynamicBodies)
+				return true;
+			
+			scene.update(world);
+			world.step(dt);
+		}
+		
+		return false;
+	}
+	
+	void print(const Result& r)
+	{
+		cout << r.scene << " bodies=" << r.bodies << " threads=" << r.threads << " dt=" << r.timestep
+			<< " mean=" << r.stepMean << "ms p99=" << r.stepP99 << "ms" << endl;
+	}
+	
+	void save(const vector<Result>& results, const string& path)
+	{
+		const bool json = ofToLower(ofFilePath::getFileExt(path)) == "json";
+		
+		stringstream ss;
+		
+		if (json)
+		{
+			ss << "[" << endl;
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				const Result& r = results[i];
+				ss << "\t{ \"scene\": \"" << r.scene << "\", \"bodies\": " << r.bodies
+					<< ", \"threads\": " << r.threads << ", \"timestep\": " << r.timestep << ", \"steps\": " << r.steps
+					<< ", \"step_min\": " << r.stepMin << ", \"step_mean\": " << r.stepMean
+					<< ", \"step_p99\": " << r.stepP99 << ", \"step_max\": " << r.stepMax
+					<< ", \"simulate_mean\": " << r.simulateMean << ", \"fetch_mean\": " << r.fetchMean
+					<< ", \"force_fields_mean\": " << r.forceFieldsMean
+					<< ", \"active_bodies\": " << r.counts.activeDynamicBodies
+					<< ", \"contact_pairs\": " << r.counts.contactPairs << " }"
+					<< (i < results.size() - 1 ? "," : "") << endl;
+			}
+			ss << "]" << endl;
+		}
+		else
+		{
+			ss << "scene,bodies,threads,timestep,steps,step_min,step_mean,step_p99,step_max,simulate_mean,fetch_mean,force_fields_mean,active_bodies,contact_pairs" << endl;
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				const Result& r = results[i];
+				ss << r.scene << "," << r.bodies << "," << r.threads << "," << r.timestep << "," << r.steps << ","
+					<< r.stepMin << "," << r.stepMean << "," << r.stepP99 << "," << r.stepMax << ","
+					<< r.simulateMean << "," << r.fetchMean << "," << r.forceFieldsMean << ","
+					<< r.counts.activeDynamicBodies << "," << r.counts.contactPairs << endl;
+			}
+		}
+		
+		ofFile file(path, ofFile::WriteOnly);
+		if (!file.is_open())
+		{
+			ofLogError("benchmark") << "can't open " << path;
+			return;
+		}
+		
+		file << ss.str();
+	}
+};
+
+static void parseOptions(int argc, const char** argv)
+{
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		const string key = argv[i];
+		const string value = argv[i + 1];
+		
+		if (key == "--scenes")
+			options.scenes = ofSplitString(value, ",", true, true);
+		else if (key == "--threads")
+		{
+			options.threads.clear();
+			vector<string> v = ofSplitString(value, ",", true, true);
+			for (size_t k = 0; k < v.size(); k++)
+				options.threads.push_back(ofToInt(v[k]));
+		}
+		else if (key == "--timesteps")
+		{
+			options.timesteps.clear();
+			vector<string> v = ofSplitString(value, ",", true, true);
+			for (size_t k = 0; k < v.size(); k++)
+				options.timesteps.push_back(ofToFloat(v[k]));
+		}
+		else if (key == "--steps")
+			options.steps = max(ofToInt(value), 1);
+		else if (key == "--warmup")
+			options.warmup = max(ofToInt(value), 0);
+		else if (key == "--out")
+			options.output = value;
+		else
+			ofLogWarning("benchmark") << "unknown option " << key;
+	}
+}
+
+
+int main(int argc, const char** argv)
+{
+	parseOptions(argc, argv);
+	
+	ofAppNoWindow window;
+	ofSetupOpenGL(&window, 1024, 768, OF_WINDOW);
+	ofRunApp(new ofApp);
+	return 0;
+}
@@ -4,7 +4,7 @@
 
 ofxPhysX::World world;
 
-ofxPhysX::RigidStatic rigid;
+ofxPhysX::RigidBody rigid;
 
 vector<ofxPhysX::RigidBody> rigids;
 
@@ -17,6 +17,8 @@ public:
 		ofSetVerticalSync(true);
 		ofBackground(0);
 		
+		showStats = false;
+		
 		world.setup(ofVec3f(0, 0, 0));
 		
 		for (int i = 0; i < 300; i++)
@@ -25,40 +27,58 @@ public:
 			rigids.push_back(world.addSphere(4, ofVec3f(ofRandom(-r, r), ofRandom(-r, r), ofRandom(-r, r))));
 		}
 		
-		rigid = world.addBox(ofVec3f(10, 10, 10), ofVec3f(), ofQuaternion(), 0);
+		// resized every frame, which is cheaper on a kinematic body than on a static
+		rigid = world.addKinematicBox(ofVec3f(10, 10, 10), ofVec3f());
+		
+		world.addForceField(ofxPhysX::ForceField::attractor(ofVec3f(0, 0, 0), 2000));
+	}
+	
+	void exit()
+	{
+		// the GL buffers go while the context is still alive
+		world.exit();
 	}
 	
 	void update()
 	{
 		world.update();
-
-		for (int i = 0; i < rigids.size(); i++)
-		{
-			ofxPhysX::RigidBody& o = rigids[i];
-			o.applyImpulseForce(o.getPosition().normalized() * -1000);
-		}
 		
 		ofVec3f s;
 		float t = 10;
 		s.x = sin(ofGetElapsedTimef() * t) + 1;
 		s.y = sin(ofGetElapsedTimef() * t + TWO_PI * 1. / 3.) + 1;
 		s.z = sin(ofGetElapsedTimef() * t + TWO_PI * 2. / 3.) + 1;
-		s *= 100;
+		s *= 200;
 		rigid.setSize(s);
 		
 		ofSetWindowTitle(ofToString(ofGetFrameRate()));
 	}
 	
 	ofEasyCam cam;
+	bool showStats;
 	void draw()
 	{
 		cam.begin();
+		ofEnableDepthTest();
+		world.drawShapes();
 		world.draw();
+		ofDisableDepthTest();
 		cam.end();
+		
+		if (showStats)
+			world.drawStats();
 	}
 
 	void keyPressed(int key)
 	{
+		if (key == 'd')
+			world.setDebugDrawEnabled(!world.isDebugDrawEnabled());
+		
+		if (key == 's')
+			showStats = !showStats;
+		
+		if (key == 'S')
+			world.getStats().save(ofGetTimestampString() + "_stats.json");
 	}
 
 	void keyReleased(int key)
@@ -2,6 +2,23 @@
 
 #include "ofxPhysXConstants.h"
 #include "ofxPhysXHelper.h"
+#include "ofxPhysXPoseCache.h"
+#include "ofxPhysXDebugRenderer.h"
+#include "ofxPhysXShapeRenderer.h"
+#include "ofxPhysXParallel.h"
+#include "ofxPhysXTaskScheduler.h"
+#include "ofxPhysXAllocator.h"
+#include "ofxPhysXSceneQuery.h"
+#include "ofxPhysXEvents.h"
+#include "ofxPhysXStats.h"
+#include "ofxPhysXSnapshot.h"
+#include "ofxPhysXCheckpoint.h"
+#include "ofxPhysXMeshCooker.h"
+#include "ofxPhysXSdk.h"
+#include "ofxPhysXForceField.h"
 #include "ofxPhysXWorld.h"
+#include "ofxPhysXWorldGroup.h"
+#include "ofxPhysXCompoundBuilder.h"
 #include "ofxPhysXRigidBody.h"
+#include "ofxPhysXRigidBodyGroup.h"
 #include "ofxPhysXRigidStatic.h"
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "ofxPhysXConstants.h"
 #include "ofxPhysXHelper.h"
+#include "ofxPhysXWorld.h"
 
 OFX_PHYSX_BEGIN_NAMESPACE
 
@@ -13,7 +14,7 @@ public:
 	
 	Actor() {}
 	virtual ~Actor() {}
-	
+
 };
 
 template <typename T>
@@ -21,49 +22,104 @@ class RigidActor_ : public Actor
 {
 public:
 	
-	RigidActor_() : actor(NULL) {}
-	RigidActor_(const RigidActor_& copy) : actor(copy.actor) {}
-	RigidActor_(physx::PxRigidActor *actor) : actor(actor) {}
+	RigidActor_() : actor(NULL), world(NULL), slot(PoseCache::INVALID_SLOT), handle(PoseCache::INVALID_HANDLE) {}
+	RigidActor_(const RigidActor_& copy) : actor(copy.actor), world(copy.world), slot(copy.slot), handle(copy.handle) {}
+	RigidActor_(physx::PxRigidActor *actor) : actor(actor), world(NULL), slot(PoseCache::INVALID_SLOT), handle(PoseCache::INVALID_HANDLE) { bind(); }
 	~RigidActor_() {}
 	
 	RigidActor_& operator=(const RigidActor_& copy)
 	{
 		actor = copy.actor;
+		world = copy.world;
+		slot = copy.slot;
+		handle = copy.handle;
 		return *this;
 	}
 	
+	// false once the actor was removed from its World, through any copy
+	inline bool isValid() const
+	{
+		if (world) return world->getPoses().isValid(handle);
+		return actor != NULL;
+	}
+	
 	virtual void release()
 	{
 		if (!actor) return;
-		actor->getScene()->removeActor(*actor);
-		actor->release();
+		
+		if (world)
+		{
+			// another copy may have removed it already, a queued actor leaves the queue
+			if (isValid())
+				world->removeActor(actor);
+		}
+		else
+		{
+			if (actor->getScene())
+				actor->getScene()->removeActor(*actor);
+			actor->release();
+		}
+		
 		actor = NULL;
+		world = NULL;
+		slot = PoseCache::INVALID_SLOT;
+		handle = PoseCache::INVALID_HANDLE;
 	}
 	
+	// Read from the World's pose cache, valid while a pipelined step is in flight.
+	// Once the actor was removed its slot may belong to another body, so these
+	// return the identity instead.
 	inline ofMatrix4x4 getTransform() const
 	{
+		if (world) return isValid() ? world->getPoses().getTransform(slot) : ofMatrix4x4();
 		return toOF(actor->getGlobalPose());
 	}
-
+	
 	inline ofVec3f getPosition() const
 	{
+		if (world) return isValid() ? world->getPoses().getPosition(slot) : ofVec3f();
 		return toOF(actor->getGlobalPose().p);
 	}
 	
 	inline ofQuaternion getRotate() const
 	{
+		if (world) return isValid() ? world->getPoses().getRotate(slot) : ofQuaternion();
 		return toOF(actor->getGlobalPose().q);
 	}
-
+	
+	inline ofMatrix4x4 getInterpolatedTransform() const
+	{
+		if (world) return isValid() ? world->getInterpolatedTransform(actor) : ofMatrix4x4();
+		return toOF(actor->getGlobalPose());
+	}
+	
+	inline World* getWorld() const { return world; }
+	inline physx::PxU32 getSlot() const { return slot; }
+	inline PoseCache::Handle getHandle() const { return handle; }
+	
+	// for actors with several shapes, the extent of their bounds in actor space
 	ofVec3f getSize() const
 	{
-		assert(actor);
-		assert(actor->getNbShapes() == 1);
+		assert(isValid());
+		if (!isValid()) return ofVec3f(0, 0, 0);
 		
-		physx::PxShape *shape;
-		actor->getShapes(&shape, 1);
+		const physx::PxU32 n = world ? world->getPoses().getNumShapes(slot) : actor->getNbShapes();
+		if (n > 1)
+		{
+			vector<physx::PxShape*> shapes(n);
+			actor->getShapes(shapes.data(), n);
+			
+			physx::PxBounds3 bounds = physx::PxBounds3::empty();
+			for (physx::PxU32 i = 0; i < n; i++)
+				bounds.include(physx::PxGeometryQuery::getWorldBounds(shapes[i]->getGeometry().any(), shapes[i]->getLocalPose(), 1));
+			
+			return toOF(bounds.getDimensions());
+		}
 		
-		physx::PxGeometryType::Enum t = shape->getGeometryType();
+		physx::PxShape *shape = getShape();
+		if (!shape) return ofVec3f(0, 0, 0);
+		
+		physx::PxGeometryType::Enum t = world ? world->getPoses().getGeometryType(slot) : shape->getGeometryType();
 		if (t == physx::PxGeometryType::eSPHERE)
 		{
 			physx::PxSphereGeometry g;
@@ -82,6 +138,26 @@ public:
 			shape->getBoxGeometry(g);
 			return toOF(g.halfExtents * 2);
 		}
+		else if (t == physx::PxGeometryType::eCONVEXMESH)
+		{
+			// meshes report their scale
+			physx::PxConvexMeshGeometry g;
+			shape->getConvexMeshGeometry(g);
+			return toOF(g.scale.scale);
+		}
+		else if (t == physx::PxGeometryType::eTRIANGLEMESH)
+		{
+			physx::PxTriangleMeshGeometry g;
+			shape->getTriangleMeshGeometry(g);
+			return toOF(g.scale.scale);
+		}
+		else if (t == physx::PxGeometryType::eHEIGHTFIELD)
+		{
+			// the scale passed to World::addHeightField()
+			physx::PxHeightFieldGeometry g;
+			shape->getHeightFieldGeometry(g);
+			return ofVec3f(g.rowScale, g.heightScale * World::MAX_HEIGHT_SAMPLE, g.columnScale);
+		}
 		else
 		{
 			ofLogWarning("ofxPhysX::RigidActor_::getSize", "unimplemented shape type");
@@ -89,47 +165,69 @@ public:
 		
 		return ofVec3f(0, 0, 0);
 	}
-
+	
+	// see World::setSize()
 	void setSize(const ofVec3f& size)
 	{
-		assert(actor);
-		assert(actor->getNbShapes() == 1);
-		
-		physx::PxShape *shape;
-		actor->getShapes(&shape, 1);
+		assert(isValid());
+		if (!isValid()) return;
 		
-		physx::PxGeometryType::Enum t = shape->getGeometryType();
-		if (t == physx::PxGeometryType::eSPHERE)
-		{
-			physx::PxSphereGeometry g(size.x);
-			shape->setGeometry(g);
-		}
-		else if (t == physx::PxGeometryType::eCAPSULE)
-		{
-			physx::PxCapsuleGeometry g(size.x, size.y);
-			shape->setGeometry(g);
-		}
-		else if (t == physx::PxGeometryType::eBOX)
+		if (world)
 		{
-			physx::PxBoxGeometry g(toPx(size));
-			shape->setGeometry(g);
+			// by handle, the actor may already belong to another body
+			world->setSizes(vector<PoseCache::Handle>(1, handle), vector<ofVec3f>(1, size));
+			return;
 		}
-		else
+		
+		if (actor->getNbShapes() != 1)
 		{
-			ofLogWarning("ofxPhysX::RigidActor_::setSize", "unimplemented shape type");
+			ofLogWarning("ofxPhysX::RigidActor_::setSize", "only single shape actors can be resized");
+			return;
 		}
+		
+		World::setGeometrySize(World::makeExclusive(actor, getShape()), size);
 	}
-
-	inline operator bool() const { return actor != NULL; }
+	
+	inline operator bool() const { return isValid(); }
 	
 	inline T* getRigid() const { return rigid; }
-
+	
+	// the first shape, cached by the World, NULL once the actor was removed
+	inline physx::PxShape* getShape() const
+	{
+		if (world) return isValid() ? world->getPoses().getShape(slot) : NULL;
+		
+		physx::PxShape *shape = NULL;
+		actor->getShapes(&shape, 1);
+		return shape;
+	}
+	
 protected:
-
+	
+	void bind()
+	{
+		world = NULL;
+		slot = PoseCache::INVALID_SLOT;
+		handle = PoseCache::INVALID_HANDLE;
+		
+		if (!actor) return;
+		
+		// set when the World creates the actor, before it joins the scene
+		handle = PoseCache::getHandle(actor);
+		slot = PoseCache::getSlot(handle);
+		
+		if (slot != PoseCache::INVALID_SLOT)
+			world = World::getWorld(actor);
+	}
+	
 	union {
 		physx::PxRigidActor *actor;
 		T *rigid;
 	};
+	
+	World *world;
+	physx::PxU32 slot;
+	PoseCache::Handle handle;
 };
 
 OFX_PHYSX_END_NAMESPACE
\ No newline at end of file
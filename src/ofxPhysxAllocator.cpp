@@ -0,0 +1,199 @@
+#include "ofxPhysXAllocator.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+static inline long long atomicAdd(volatile long long *value, long long delta)
+{
+#ifdef TARGET_WIN32
+	return InterlockedExchangeAdd64(value, delta) + delta;
+#else
+	return __sync_add_and_fetch(value, delta);
+#endif
+}
+
+static inline bool atomicCompareExchange(volatile long long *value, long long expected, long long desired)
+{
+#ifdef TARGET_WIN32
+	return InterlockedCompareExchange64(value, desired, expected) == expected;
+#else
+	return __sync_bool_compare_and_swap(value, expected, desired);
+#endif
+}
+
+Allocator::Allocator() :
+	liveBytes(0),
+	peakBytes(0),
+	pooledBytes(0),
+	numAllocations(0),
+	totalAllocations(0),
+	tagTracking(true)
+{
+	for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+		pools[i].blockSize = sizeof(Header) + (MIN_BLOCK_SIZE << i);
+	
+	// tag 0 collects everything allocated without tracking
+	tagNames.push_back("untracked");
+	for (int i = 0; i < MAX_TAGS; i++)
+		tagBytes[i] = 0;
+}
+
+Allocator::~Allocator()
+{
+	for (int i = 0; i < NUM_SIZE_CLASSES; i++)
+	{
+		Pool& pool = pools[i];
+		for (size_t k = 0; k < pool.chunks.size(); k++)
+			deallocateAligned(pool.chunks[k]);
+		pool.chunks.clear();
+		pool.freeList = NULL;
+	}
+}
+
+void* Allocator::allocate(size_t size, const char* typeName, const char* filename, int line)
+{
+	if (size == 0) return NULL;
+	
+	int sizeClass = 0;
+	while (sizeClass < NUM_SIZE_CLASSES && (size_t)(MIN_BLOCK_SIZE << sizeClass) < size)
+		sizeClass++;
+	
+	Header *header;
+	
+	if (sizeClass < NUM_SIZE_CLASSES)
+	{
+		Pool& pool = pools[sizeClass];
+		Poco::FastMutex::ScopedLock lock(pool.mutex);
+		
+		if (!pool.freeList)
+		{
+			char *chunk = (char*)allocateAligned(CHUNK_SIZE);
+			if (!chunk) return NULL;
+			
+			pool.chunks.push_back(chunk);
+			atomicAdd(&pooledBytes, CHUNK_SIZE);
+			
+			const size_t n = CHUNK_SIZE / pool.blockSize;
+			for (size_t i = 0; i < n; i++)
+			{
+				void *block = chunk + i * pool.blockSize;
+				*(void**)block = pool.freeList;
+				pool.freeList = block;
+			}
+		}
+		
+		header = (Header*)pool.freeList;
+		pool.freeList = *(void**)pool.freeList;
+	}
+	else
+	{
+		header = (Header*)allocateAligned(sizeof(Header) + size);
+		if (!header) return NULL;
+		
+		sizeClass = LARGE;
+	}
+	
+	header->size = size;
+	header->sizeClass = sizeClass;
+	header->tag = tagTracking ? getTag(typeName) : 0;
+	
+	long long live = atomicAdd(&liveBytes, size);
+	numAllocations++;
+	totalAllocations++;
+	
+	long long peak = peakBytes;
+	while (live > peak && !atomicCompareExchange(&peakBytes, peak, live))
+		peak = peakBytes;
+	
+	if (header->tag)
+		atomicAdd(&tagBytes[header->tag], size);
+	
+	return header + 1;
+}
+
+void Allocator::deallocate(void* ptr)
+{
+	if (!ptr) return;
+	
+	Header *header = (Header*)ptr - 1;
+	
+	atomicAdd(&liveBytes, -(long long)header->size);
+	numAllocations--;
+	
+	if (header->tag)
+		atomicAdd(&tagBytes[header->tag], -(long long)header->size);
+	
+	if (header->sizeClass == LARGE)
+	{
+		deallocateAligned(header);
+		return;
+	}
+	
+	Pool& pool = pools[header->sizeClass];
+	Poco::FastMutex::ScopedLock lock(pool.mutex);
+	
+	*(void**)header = pool.freeList;
+	pool.freeList = header;
+}
+
+Allocator::Stats Allocator::getStats() const
+{
+	Stats s;
+	s.liveBytes = liveBytes;
+	s.peakBytes = peakBytes;
+	s.pooledBytes = pooledBytes;
+	s.numAllocations = numAllocations.value();
+	s.totalAllocations = totalAllocations.value();
+	return s;
+}
+
+void Allocator::getTagStats(map<string, size_t>& liveBytesByTag) const
+{
+	Poco::FastMutex::ScopedLock lock(tagMutex);
+	
+	liveBytesByTag.clear();
+	for (size_t i = 1; i < tagNames.size(); i++)
+		liveBytesByTag[tagNames[i]] += tagBytes[i];
+}
+
+physx::PxU16 Allocator::getTag(const char *typeName)
+{
+	if (!typeName) return 0;
+	
+	Poco::FastMutex::ScopedLock lock(tagMutex);
+	
+	// PhysX passes string literals, so the pointer identifies the tag
+	map<const char*, physx::PxU16>::const_iterator it = tagsByName.find(typeName);
+	if (it != tagsByName.end())
+		return it->second;
+	
+	if (tagNames.size() >= MAX_TAGS)
+		return 0;
+	
+	physx::PxU16 tag = tagNames.size();
+	tagNames.push_back(typeName);
+	tagsByName[typeName] = tag;
+	return tag;
+}
+
+void* Allocator::allocateAligned(size_t size)
+{
+#ifdef TARGET_WIN32
+	return _aligned_malloc(size, ALIGNMENT);
+#else
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, ALIGNMENT, size) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+void Allocator::deallocateAligned(void *ptr)
+{
+#ifdef TARGET_WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+OFX_PHYSX_END_NAMESPACE
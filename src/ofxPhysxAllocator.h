@@ -0,0 +1,96 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+
+#include "Poco/Mutex.h"
+#include "Poco/AtomicCounter.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Size-class pools for the small, frequent PhysX allocations, 16 byte aligned.
+// Pools grow in chunks and keep freed blocks for reuse, so memory plateaus at
+// the peak instead of fragmenting the heap. Larger blocks go to the system.
+class Allocator : public physx::PxAllocatorCallback
+{
+public:
+	
+	struct Stats
+	{
+		Stats() : liveBytes(0), peakBytes(0), pooledBytes(0), numAllocations(0), totalAllocations(0) {}
+		
+		size_t liveBytes;
+		size_t peakBytes;
+		size_t pooledBytes;		// reserved by the pools, used or not
+		size_t numAllocations;
+		size_t totalAllocations;
+	};
+	
+	Allocator();
+	virtual ~Allocator();
+	
+	void* allocate(size_t size, const char* typeName, const char* filename, int line);
+	void deallocate(void* ptr);
+	
+	// per typeName byte counters, only meaningful when PhysX reports allocation names
+	inline void setTagTracking(bool yn) { tagTracking = yn; }
+	inline bool isTagTracking() const { return tagTracking; }
+	
+	Stats getStats() const;
+	void getTagStats(map<string, size_t>& liveBytesByTag) const;
+	
+	enum
+	{
+		ALIGNMENT = 16,
+		NUM_SIZE_CLASSES = 9,	// 16 .. 4096 bytes
+		MIN_BLOCK_SIZE = 16,
+		MAX_POOLED_SIZE = MIN_BLOCK_SIZE << (NUM_SIZE_CLASSES - 1),
+		CHUNK_SIZE = 64 * 1024,
+		LARGE = 0xffff,
+		MAX_TAGS = 1024
+	};
+	
+protected:
+	
+	// keeps the user block 16 byte aligned
+	struct Header
+	{
+		physx::PxU32 size;
+		physx::PxU16 sizeClass;
+		physx::PxU16 tag;
+		physx::PxU32 reserved[2];
+	};
+	
+	struct Pool
+	{
+		Pool() : blockSize(0), freeList(NULL) {}
+		
+		Poco::FastMutex mutex;
+		size_t blockSize;
+		void *freeList;
+		vector<void*> chunks;
+	};
+	
+	static void* allocateAligned(size_t size);
+	static void deallocateAligned(void *ptr);
+	
+	physx::PxU16 getTag(const char *typeName);
+	
+	Pool pools[NUM_SIZE_CLASSES];
+	
+	// byte counters need an atomic add, Poco::AtomicCounter only steps by one
+	volatile long long liveBytes;
+	volatile long long peakBytes;
+	volatile long long pooledBytes;
+	Poco::AtomicCounter numAllocations;
+	Poco::AtomicCounter totalAllocations;
+	
+	bool tagTracking;
+	
+	// the mutex only guards interning, tag byte counters are updated without it
+	mutable Poco::FastMutex tagMutex;
+	map<const char*, physx::PxU16> tagsByName;
+	vector<const char*> tagNames;
+	volatile long long tagBytes[MAX_TAGS];
+};
+
+OFX_PHYSX_END_NAMESPACE
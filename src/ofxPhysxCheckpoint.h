@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXPoseCache.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Dynamic state of the dynamic bodies of a World at one step, see
+// World::checkpoint() and World::restore(). Buffers are kept between captures,
+// so taking a checkpoint every frame doesn't allocate once it has grown.
+class Checkpoint
+{
+public:
+	
+	struct BodyState
+	{
+		enum
+		{
+			ASLEEP = 1 << 0,
+			KINEMATIC = 1 << 1
+		};
+		
+		physx::PxTransform pose;
+		physx::PxVec3 linearVelocity;
+		physx::PxVec3 angularVelocity;
+		physx::PxReal wakeCounter;
+		physx::PxU32 slot;
+		physx::PxU32 flags;
+	};
+	
+	Checkpoint() : accumulator(0), interpolationAlpha(1) {}
+	
+	inline void reserve(size_t numBodies)
+	{
+		states.reserve(numBodies);
+		handles.reserve(numBodies);
+	}
+	
+	inline void clear()
+	{
+		states.clear();
+		handles.clear();
+	}
+	
+	inline size_t size() const { return states.size(); }
+	inline bool empty() const { return states.empty(); }
+	
+	inline const vector<BodyState>& getStates() const { return states; }
+	
+protected:
+	
+	friend class World;
+	
+	vector<BodyState> states;
+	
+	// restore() skips bodies removed since, even when their slot or their pooled
+	// PhysX actor was reused
+	vector<PoseCache::Handle> handles;
+	
+	float accumulator;
+	float interpolationAlpha;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,141 @@
+#include "ofxPhysXCompoundBuilder.h"
+#include "ofxPhysXWorldScale.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+CompoundBuilder::CompoundBuilder() :
+	world(NULL),
+	group(World::DEFAULT_GROUP),
+	mass(0),
+	massFrame(physx::PxTransform::createIdentity()),
+	inertia(0, 0, 0)
+{
+}
+
+CompoundBuilder::~CompoundBuilder()
+{
+	clear();
+}
+
+CompoundBuilder& CompoundBuilder::addBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxMaterial *material)
+{
+	return addPart(physx::PxBoxGeometry(toPx(size / 2)), pos, rot, density, material);
+}
+
+CompoundBuilder& CompoundBuilder::addSphere(float radius, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxMaterial *material)
+{
+	return addPart(physx::PxSphereGeometry(radius), pos, rot, density, material);
+}
+
+CompoundBuilder& CompoundBuilder::addCapsule(float radius, float height, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxMaterial *material)
+{
+	return addPart(physx::PxCapsuleGeometry(radius, height / 2), pos, rot, density, material);
+}
+
+CompoundBuilder& CompoundBuilder::addConvexMesh(physx::PxConvexMesh *mesh, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxMaterial *material)
+{
+	assert(mesh);
+	return addPart(physx::PxConvexMeshGeometry(mesh), pos, rot, density, material);
+}
+
+CompoundBuilder& CompoundBuilder::addPart(const physx::PxGeometry& geometry, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxMaterial *material)
+{
+	if (isBuilt())
+		ofLogWarning("ofxPhysX::CompoundBuilder") << "parts added after build() take effect at the next build()";
+	
+	Part part;
+	part.geometry.storeAny(geometry);
+	toPx(pos, part.pose.p);
+	toPx(rot, part.pose.q);
+	part.material = material;
+	part.density = density;
+	
+	parts.push_back(part);
+	return *this;
+}
+
+bool CompoundBuilder::build(World& world_, physx::PxU32 group_, physx::PxU32 mask)
+{
+	releaseShapes();
+	
+	physx::PxPhysics *physics = world_.getPhysics();
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::CompoundBuilder") << "setup the World first";
+		return false;
+	}
+	
+	if (parts.empty())
+	{
+		ofLogError("ofxPhysX::CompoundBuilder") << "no parts";
+		return false;
+	}
+	
+	vector<physx::PxMassProperties> props;
+	vector<physx::PxTransform> transforms;
+	
+	for (size_t i = 0; i < parts.size(); i++)
+	{
+		const Part& part = parts[i];
+		physx::PxMaterial *material = part.material ? part.material : world_.getDefaultMaterial();
+		
+		physx::PxShape *shape = physics->createShape(part.geometry.any(), *material, false);
+		if (!shape)
+		{
+			ofLogError("ofxPhysX::CompoundBuilder") << "can't create part " << i;
+			releaseShapes();
+			return false;
+		}
+		
+		shape->setLocalPose(part.pose);
+		shape->setSimulationFilterData(physx::PxFilterData(group_, mask, 0, 0));
+		shape->setQueryFilterData(physx::PxFilterData(group_, 0, 0, 0));
+		shapes.push_back(shape);
+		
+		if (part.density > 0)
+		{
+			props.push_back(physx::PxMassProperties(part.geometry.any()) * (part.density * WorldScale::getInvDensityScale()));
+			transforms.push_back(part.pose);
+		}
+	}
+	
+	mass = 0;
+	massFrame = physx::PxTransform::createIdentity();
+	inertia = physx::PxVec3(0, 0, 0);
+	
+	if (!props.empty())
+	{
+		physx::PxMassProperties total = physx::PxMassProperties::sum(props.data(), transforms.data(), props.size());
+		
+		physx::PxQuat orient;
+		inertia = physx::PxMassProperties::getMassSpaceInertia(total.inertiaTensor, orient);
+		massFrame = physx::PxTransform(total.centerOfMass, orient);
+		mass = total.mass;
+	}
+	
+	world = &world_;
+	group = group_;
+	world->compounds.insert(this);
+	
+	return true;
+}
+
+void CompoundBuilder::clear()
+{
+	releaseShapes();
+	parts.clear();
+}
+
+void CompoundBuilder::releaseShapes()
+{
+	// instances keep their own references
+	for (size_t i = 0; i < shapes.size(); i++)
+		shapes[i]->release();
+	shapes.clear();
+	
+	if (world)
+		world->compounds.erase(this);
+	world = NULL;
+}
+
+OFX_PHYSX_END_NAMESPACE
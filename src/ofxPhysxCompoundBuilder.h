@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+#include "ofxPhysXWorld.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Collects shapes with local poses, materials and densities into a prototype body.
+// build() creates the shared shapes and sums the mass, center of mass and inertia
+// once; World::addCompound() then only attaches the shapes and copies the mass
+// properties. The shapes belong to the World passed to build() and are released
+// by clear() or by World::clear(), whichever comes first.
+class CompoundBuilder
+{
+public:
+	
+	CompoundBuilder();
+	~CompoundBuilder();
+	
+	// pos and rot are relative to the body, a NULL material uses the World's default
+	CompoundBuilder& addBox(const ofVec3f& size, const ofVec3f& pos = ofVec3f(), const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxMaterial *material = NULL);
+	CompoundBuilder& addSphere(float radius, const ofVec3f& pos = ofVec3f(), const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxMaterial *material = NULL);
+	CompoundBuilder& addCapsule(float radius, float height, const ofVec3f& pos = ofVec3f(), const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxMaterial *material = NULL);
+	CompoundBuilder& addConvexMesh(physx::PxConvexMesh *mesh, const ofVec3f& pos = ofVec3f(), const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxMaterial *material = NULL);
+	
+	// instances are static when every part has density 0
+	bool build(World& world, physx::PxU32 group = World::DEFAULT_GROUP, physx::PxU32 mask = World::ALL_GROUPS);
+	
+	// drops the parts and releases the built shapes
+	void clear();
+	
+	inline size_t size() const { return parts.size(); }
+	inline bool isBuilt() const { return world != NULL; }
+	inline World* getWorld() const { return world; }
+	
+	inline float getMass() const { return mass; }
+	inline ofVec3f getCenterOfMass() const { return toOF(massFrame.p); }
+	inline ofVec3f getInertia() const { return toOF(inertia); }
+	
+protected:
+	
+	friend class World;
+	
+	struct Part
+	{
+		physx::PxGeometryHolder geometry;
+		physx::PxTransform pose;
+		physx::PxMaterial *material;
+		float density;
+	};
+	
+	CompoundBuilder& addPart(const physx::PxGeometry& geometry, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxMaterial *material);
+	void releaseShapes();
+	
+	vector<Part> parts;
+	
+	World *world;
+	vector<physx::PxShape*> shapes;
+	physx::PxU32 group;
+	
+	physx::PxReal mass;
+	physx::PxTransform massFrame;
+	physx::PxVec3 inertia;
+	
+private:
+	
+	CompoundBuilder(const CompoundBuilder&);
+	CompoundBuilder& operator=(const CompoundBuilder&);
+};
+
+OFX_PHYSX_END_NAMESPACE
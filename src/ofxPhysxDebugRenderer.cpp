@@ -0,0 +1,104 @@
+#include "ofxPhysXDebugRenderer.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+void DebugRenderer::update(const physx::PxRenderBuffer& buffer)
+{
+	const physx::PxU32 numLines = buffer.getNbLines();
+	const physx::PxDebugLine* PX_RESTRICT srcLines = buffer.getLines();
+	
+	lines.vertices.resize(numLines * 2);
+	Vertex *v = lines.vertices.data();
+	
+	for (physx::PxU32 i = 0; i < numLines; i++)
+	{
+		const physx::PxDebugLine& line = srcLines[i];
+		v[0].set(line.pos0, line.color0);
+		v[1].set(line.pos1, line.color0);
+		v += 2;
+	}
+	
+	const physx::PxU32 numTriangles = buffer.getNbTriangles();
+	const physx::PxDebugTriangle* PX_RESTRICT srcTriangles = buffer.getTriangles();
+	
+	triangles.vertices.resize(numTriangles * 3);
+	v = triangles.vertices.data();
+	
+	for (physx::PxU32 i = 0; i < numTriangles; i++)
+	{
+		const physx::PxDebugTriangle& triangle = srcTriangles[i];
+		v[0].set(triangle.pos0, triangle.color0);
+		v[1].set(triangle.pos1, triangle.color0);
+		v[2].set(triangle.pos2, triangle.color0);
+		v += 3;
+	}
+}
+
+void DebugRenderer::draw()
+{
+	lines.upload();
+	triangles.upload();
+	
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	
+	lines.draw(GL_LINES);
+	triangles.draw(GL_TRIANGLES);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+void DebugRenderer::clear()
+{
+	lines.vertices.clear();
+	triangles.vertices.clear();
+}
+
+void DebugRenderer::release()
+{
+	lines.release();
+	triangles.release();
+}
+
+//
+
+void DebugRenderer::Stream::upload()
+{
+	if (vertices.empty()) return;
+	
+	if (!vbo)
+		glGenBuffers(1, &vbo);
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	
+	// grow geometrically so the buffer is only reallocated in bursts
+	if (vertices.size() > capacity)
+		capacity = max(vertices.size(), capacity * 2);
+	
+	// orphan last frame's storage so the driver doesn't stall on it
+	glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Vertex), NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data());
+}
+
+void DebugRenderer::Stream::draw(GLenum mode)
+{
+	if (vertices.empty()) return;
+	
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glVertexPointer(3, GL_FLOAT, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, pos));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), (const GLvoid*)offsetof(Vertex, color));
+	glDrawArrays(mode, 0, vertices.size());
+}
+
+void DebugRenderer::Stream::release()
+{
+	if (vbo)
+		glDeleteBuffers(1, &vbo);
+	vbo = 0;
+	capacity = 0;
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+class DebugRenderer
+{
+public:
+	
+	DebugRenderer() {}
+	
+	// copy the scene's debug geometry, no GL calls
+	void update(const physx::PxRenderBuffer& buffer);
+	
+	// upload into the streamed buffers and draw each primitive type in one call
+	void draw();
+	
+	void clear();
+	
+	// frees the GL buffers, not done on destruction which may outlive the context
+	void release();
+	
+	inline size_t getNumLines() const { return lines.vertices.size() / 2; }
+	inline size_t getNumTriangles() const { return triangles.vertices.size() / 3; }
+	
+protected:
+	
+	struct Vertex
+	{
+		float pos[3];
+		unsigned char color[4];
+		
+		inline void set(const physx::PxVec3& p, physx::PxU32 c)
+		{
+			pos[0] = p.x;
+			pos[1] = p.y;
+			pos[2] = p.z;
+			
+			// PxDebugColor is 0xAARRGGBB, alpha is ignored like ofSetHexColor
+			color[0] = (c >> 16) & 0xff;
+			color[1] = (c >> 8) & 0xff;
+			color[2] = c & 0xff;
+			color[3] = 0xff;
+		}
+	};
+	
+	struct Stream
+	{
+		Stream() : vbo(0), capacity(0) {}
+		
+		void upload();
+		void draw(GLenum mode);
+		void release();
+		
+		GLuint vbo;
+		size_t capacity;
+		vector<Vertex> vertices;
+	};
+	
+	Stream lines;
+	Stream triangles;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,225 @@
+#include "ofxPhysXEvents.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// a full barrier read, the records behind the index are visible after it
+static inline long long atomicLoad(volatile long long *value)
+{
+#ifdef TARGET_WIN32
+	return InterlockedCompareExchange64(value, 0, 0);
+#else
+	return __sync_fetch_and_add(value, 0);
+#endif
+}
+
+// the writes before it are visible to whoever loads the new value
+static inline void atomicStore(volatile long long *value, long long v)
+{
+#ifdef TARGET_WIN32
+	InterlockedExchange64(value, v);
+#else
+	__sync_synchronize();
+	__sync_lock_test_and_set(value, v);
+#endif
+}
+
+EventQueue::EventQueue(size_t capacity) : mask(0), head(0), tail(0), dropped(0)
+{
+	setCapacity(capacity);
+}
+
+void EventQueue::setCapacity(size_t capacity)
+{
+	size_t n = 1;
+	while (n < capacity) n <<= 1;
+	
+	buffer.resize(n);
+	mask = n - 1;
+	head = tail = 0;
+	dropped = 0;
+}
+
+bool EventQueue::push(const Event& e)
+{
+	const long long h = head;
+	const long long t = atomicLoad(&tail);
+	
+	if ((size_t)(h - t) >= buffer.size())
+	{
+		dropped++;
+		return false;
+	}
+	
+	buffer[h & mask] = e;
+	
+	// publish the record before the new head
+	atomicStore(&head, h + 1);
+	
+	return true;
+}
+
+bool EventQueue::pop(Event& e)
+{
+	return pop(&e, 1) == 1;
+}
+
+size_t EventQueue::pop(Event *events, size_t maxEvents)
+{
+	const long long t = tail;
+	const long long h = atomicLoad(&head);
+	
+	size_t n = min((size_t)(h - t), maxEvents);
+	for (size_t i = 0; i < n; i++)
+		events[i] = buffer[(t + i) & mask];
+	
+	// the slots may be reused only after they were read
+	atomicStore(&tail, t + n);
+	
+	return n;
+}
+
+size_t EventQueue::size() const
+{
+	const long long t = atomicLoad(const_cast<volatile long long*>(&tail));
+	const long long h = atomicLoad(const_cast<volatile long long*>(&head));
+	return h - t;
+}
+
+//
+
+static inline PoseCache::Handle getHandle(const physx::PxActor *actor)
+{
+	return actor ? PoseCache::getHandle(actor) : PoseCache::INVALID_HANDLE;
+}
+
+namespace
+{
+	struct CallbackTimer
+	{
+		CallbackTimer(SimulationEventCallback *callback) : callback(callback->timing ? callback : NULL), start(0)
+		{
+			if (this->callback) start = ofGetElapsedTimeMicros();
+		}
+		
+		~CallbackTimer()
+		{
+			if (callback) callback->elapsedMicros += ofGetElapsedTimeMicros() - start;
+		}
+		
+		SimulationEventCallback *callback;
+		unsigned long long start;
+	};
+}
+
+void SimulationEventCallback::onWake(physx::PxActor** actors, physx::PxU32 count)
+{
+	pushActors(Event::WAKE, actors, count);
+}
+
+void SimulationEventCallback::onSleep(physx::PxActor** actors, physx::PxU32 count)
+{
+	pushActors(Event::SLEEP, actors, count);
+}
+
+void SimulationEventCallback::pushActors(Event::Type type, physx::PxActor** actors, physx::PxU32 count)
+{
+	if (!queue) return;
+	
+	CallbackTimer timer(this);
+	
+	for (physx::PxU32 i = 0; i < count; i++)
+	{
+		Event e;
+		memset(&e, 0, sizeof(e));
+		e.type = type;
+		e.actor0 = actors[i]->isRigidActor();
+		e.handle0 = getHandle(actors[i]);
+		e.handle1 = PoseCache::INVALID_HANDLE;
+		queue->push(e);
+	}
+}
+
+void SimulationEventCallback::onContact(const physx::PxContactPairHeader& pairHeader, const physx::PxContactPair* pairs, physx::PxU32 nbPairs)
+{
+	if (!queue) return;
+	
+	CallbackTimer timer(this);
+	
+	const bool removed0 = pairHeader.flags & physx::PxContactPairHeaderFlag::eREMOVED_ACTOR_0;
+	const bool removed1 = pairHeader.flags & physx::PxContactPairHeaderFlag::eREMOVED_ACTOR_1;
+	
+	for (physx::PxU32 i = 0; i < nbPairs; i++)
+	{
+		const physx::PxContactPair& pair = pairs[i];
+		
+		Event e;
+		memset(&e, 0, sizeof(e));
+		
+		// pairs with a force threshold report the threshold events instead
+		if (pair.events & (physx::PxPairFlag::eNOTIFY_TOUCH_FOUND | physx::PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND))
+			e.type = Event::CONTACT_BEGIN;
+		else if (pair.events & (physx::PxPairFlag::eNOTIFY_TOUCH_PERSISTS | physx::PxPairFlag::eNOTIFY_THRESHOLD_FORCE_PERSISTS))
+			e.type = Event::CONTACT_PERSIST;
+		else if (pair.events & (physx::PxPairFlag::eNOTIFY_TOUCH_LOST | physx::PxPairFlag::eNOTIFY_THRESHOLD_FORCE_LOST))
+			e.type = Event::CONTACT_END;
+		else
+			continue;
+		
+		e.actor0 = removed0 ? NULL : pairHeader.actors[0];
+		e.actor1 = removed1 ? NULL : pairHeader.actors[1];
+		e.handle0 = removed0 ? PoseCache::INVALID_HANDLE : getHandle(pairHeader.actors[0]);
+		e.handle1 = removed1 ? PoseCache::INVALID_HANDLE : getHandle(pairHeader.actors[1]);
+		
+		if (e.type != Event::CONTACT_END && pair.contactCount > 0)
+		{
+			points.resize(pair.contactCount);
+			physx::PxU32 n = pair.extractContacts(points.data(), points.size());
+			
+			physx::PxVec3 impulse(0, 0, 0);
+			for (physx::PxU32 k = 0; k < n; k++)
+				impulse += points[k].impulse;
+			
+			e.impulse = impulse.magnitude();
+			
+			if (n > 0)
+			{
+				const physx::PxContactPairPoint& p = points[0];
+				e.position[0] = p.position.x;
+				e.position[1] = p.position.y;
+				e.position[2] = p.position.z;
+				e.normal[0] = p.normal.x;
+				e.normal[1] = p.normal.y;
+				e.normal[2] = p.normal.z;
+			}
+		}
+		
+		queue->push(e);
+	}
+}
+
+void SimulationEventCallback::onTrigger(physx::PxTriggerPair* pairs, physx::PxU32 count)
+{
+	if (!queue) return;
+	
+	CallbackTimer timer(this);
+	
+	for (physx::PxU32 i = 0; i < count; i++)
+	{
+		const physx::PxTriggerPair& pair = pairs[i];
+		
+		// skip pairs whose shapes were removed from the scene
+		if (pair.flags & (physx::PxTriggerPairFlag::eREMOVED_SHAPE_TRIGGER | physx::PxTriggerPairFlag::eREMOVED_SHAPE_OTHER))
+			continue;
+		
+		Event e;
+		memset(&e, 0, sizeof(e));
+		e.type = pair.status == physx::PxPairFlag::eNOTIFY_TOUCH_FOUND ? Event::TRIGGER_ENTER : Event::TRIGGER_LEAVE;
+		e.actor0 = pair.triggerActor;
+		e.actor1 = pair.otherActor;
+		e.handle0 = getHandle(pair.triggerActor);
+		e.handle1 = getHandle(pair.otherActor);
+		queue->push(e);
+	}
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+#include "ofxPhysXPoseCache.h"
+
+#include "Poco/AtomicCounter.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+struct Event
+{
+	enum Type
+	{
+		CONTACT_BEGIN,
+		CONTACT_PERSIST,
+		CONTACT_END,
+		TRIGGER_ENTER,
+		TRIGGER_LEAVE,
+		SLEEP,
+		WAKE
+	};
+	
+	// what an actor asks to be reported, see World::setEventReporting()
+	enum Report
+	{
+		REPORT_NONE = 0,
+		REPORT_CONTACT_BEGIN = 1 << 0,
+		REPORT_CONTACT_PERSIST = 1 << 1,
+		REPORT_CONTACT_END = 1 << 2,
+		REPORT_SLEEP_WAKE = 1 << 3,
+		REPORT_CONTACTS = REPORT_CONTACT_BEGIN | REPORT_CONTACT_END,
+		REPORT_ALL = 0xf
+	};
+	
+	physx::PxU32 type;
+	
+	// pose cache handles, INVALID_HANDLE for actors already removed; check them
+	// with PoseCache::isValid() or World::getActor(), the actor may be removed
+	// and its slot reused by the time the event is consumed
+	PoseCache::Handle handle0, handle1;
+	
+	// only safe to dereference on the thread calling World::update()
+	physx::PxRigidActor *actor0, *actor1;
+	
+	// contacts: summed impulse magnitude, first contact point and normal
+	float impulse;
+	float position[3];
+	float normal[3];
+	
+	inline ofVec3f getPosition() const { return ofVec3f(position[0], position[1], position[2]); }
+	inline ofVec3f getNormal() const { return ofVec3f(normal[0], normal[1], normal[2]); }
+};
+
+// Single producer / single consumer ring of Events. World pushes while fetching
+// results, one other thread can pop without locks. When full, new events are
+// dropped and counted rather than blocking the simulation.
+class EventQueue
+{
+public:
+	
+	EventQueue(size_t capacity = 4096);
+	
+	// rounded up to a power of two, not thread safe, call before consuming
+	void setCapacity(size_t capacity);
+	inline size_t getCapacity() const { return buffer.size(); }
+	
+	// producer
+	bool push(const Event& e);
+	
+	// consumer
+	bool pop(Event& e);
+	size_t pop(Event *events, size_t maxEvents);
+	
+	size_t size() const;
+	inline bool empty() const { return size() == 0; }
+	
+	inline size_t getNumDropped() const { return (size_t)dropped.value(); }
+	
+protected:
+	
+	vector<Event> buffer;
+	size_t mask;
+	
+	// each index is only written by one side, the producer moves head and the
+	// consumer moves tail
+	volatile long long head;
+	volatile long long tail;
+	Poco::AtomicCounter dropped;
+};
+
+class SimulationEventCallback : public physx::PxSimulationEventCallback
+{
+public:
+	
+	SimulationEventCallback() : queue(NULL), timing(false), elapsedMicros(0) {}
+	
+	void onConstraintBreak(physx::PxConstraintInfo* constraints, physx::PxU32 count) {}
+	void onWake(physx::PxActor** actors, physx::PxU32 count);
+	void onSleep(physx::PxActor** actors, physx::PxU32 count);
+	void onContact(const physx::PxContactPairHeader& pairHeader, const physx::PxContactPair* pairs, physx::PxU32 nbPairs);
+	void onTrigger(physx::PxTriggerPair* pairs, physx::PxU32 count);
+	
+	EventQueue *queue;
+	
+	// time spent in the callbacks, accumulated while timing is set
+	bool timing;
+	unsigned long long elapsedMicros;
+	
+protected:
+	
+	void pushActors(Event::Type type, physx::PxActor** actors, physx::PxU32 count);
+	
+	vector<physx::PxContactPairPoint> points;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,245 @@
+#include "ofxPhysXForceField.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+ForceField ForceField::attractor(const ofVec3f& position, float strength, float radius, Falloff falloff)
+{
+	ForceField f;
+	f.type = ATTRACTOR;
+	f.position = position;
+	f.strength = strength;
+	f.shape = radius > 0 ? SPHERE : INFINITE;
+	f.size.set(radius > 0 ? radius : 1);
+	f.falloff = falloff;
+	return f;
+}
+
+ForceField ForceField::radial(const ofVec3f& position, float strength, float radius, Falloff falloff)
+{
+	ForceField f = attractor(position, strength, radius, falloff);
+	f.type = RADIAL;
+	return f;
+}
+
+ForceField ForceField::vortex(const ofVec3f& position, const ofVec3f& axis, float strength, float radius, Falloff falloff)
+{
+	ForceField f = attractor(position, strength, radius, falloff);
+	f.type = VORTEX;
+	f.axis = axis.getNormalized();
+	return f;
+}
+
+ForceField ForceField::drag(const ofVec3f& position, const ofVec3f& halfExtents, float strength)
+{
+	ForceField f;
+	f.type = DRAG;
+	f.shape = BOX;
+	f.falloff = CONSTANT;
+	f.position = position;
+	f.size = halfExtents;
+	f.strength = strength;
+	return f;
+}
+
+//
+
+size_t ForceFieldSystem::add(const ForceField& field)
+{
+	if (!freeIds.empty())
+	{
+		size_t id = freeIds.back();
+		freeIds.pop_back();
+		fields[id] = field;
+		freed[id] = 0;
+		return id;
+	}
+	
+	fields.push_back(field);
+	freed.push_back(0);
+	return fields.size() - 1;
+}
+
+void ForceFieldSystem::remove(size_t id)
+{
+	if (id >= fields.size() || freed[id]) return;
+	
+	freed[id] = 1;
+	freeIds.push_back(id);
+}
+
+void ForceFieldSystem::clear()
+{
+	fields.clear();
+	freeIds.clear();
+	freed.clear();
+}
+
+void ForceFieldSystem::apply(const PoseCache& poses, physx::PxCpuDispatcher *dispatcher)
+{
+	active.clear();
+	needsVelocities = false;
+	
+	for (size_t i = 0; i < fields.size(); i++)
+	{
+		if (!freed[i] && fields[i].enabled && fields[i].strength != 0)
+		{
+			active.push_back(fields[i]);
+			needsVelocities |= fields[i].type == ForceField::DRAG;
+		}
+	}
+	
+	if (active.empty()) return;
+	
+	// bodies at rest or asleep didn't make it into the active transforms
+	const vector<physx::PxU32>& slots = poses.getActiveSlots();
+	
+	bodies.clear();
+	groups.clear();
+	px.clear();
+	py.clear();
+	pz.clear();
+	
+	for (size_t i = 0; i < slots.size(); i++)
+	{
+		const physx::PxU32 slot = slots[i];
+		
+		// kinematic bodies only follow their targets
+		physx::PxRigidDynamic *body = poses.getDynamic(slot);
+		if (!body || poses.isKinematic(slot)) continue;
+		
+		const ofVec3f& p = poses.getPosition(slot);
+		bodies.push_back(body);
+		groups.push_back(poses.getGroup(slot));
+		px.push_back(p.x);
+		py.push_back(p.y);
+		pz.push_back(p.z);
+	}
+	
+	const size_t n = bodies.size();
+	if (n == 0) return;
+	
+	if (needsVelocities)
+	{
+		vx.resize(n);
+		vy.resize(n);
+		vz.resize(n);
+		
+		for (size_t i = 0; i < n; i++)
+		{
+			const physx::PxVec3 v = bodies[i]->getLinearVelocity();
+			vx[i] = v.x;
+			vy[i] = v.y;
+			vz[i] = v.z;
+		}
+	}
+	
+	ax.resize(n);
+	ay.resize(n);
+	az.resize(n);
+	touched.resize(n);
+	
+	if (multithreaded)
+		parallelFor(dispatcher, *this, n, 1024);
+	else
+		execute(0, n);
+	
+	// PhysX writes stay on the calling thread; bodies that fell asleep in the
+	// last step stay asleep
+	for (size_t i = 0; i < n; i++)
+	{
+		if (touched[i])
+			bodies[i]->addForce(physx::PxVec3(ax[i], ay[i], az[i]), physx::PxForceMode::eACCELERATION, false);
+	}
+}
+
+template <int TYPE>
+void ForceFieldSystem::accumulate(const ForceField& f, size_t begin, size_t end)
+{
+	const physx::PxU32* PX_RESTRICT G = groups.data();
+	const float* PX_RESTRICT X = px.data();
+	const float* PX_RESTRICT Y = py.data();
+	const float* PX_RESTRICT Z = pz.data();
+	float* PX_RESTRICT AX = ax.data();
+	float* PX_RESTRICT AY = ay.data();
+	float* PX_RESTRICT AZ = az.data();
+	unsigned char* PX_RESTRICT T = touched.data();
+	
+	const float cx = f.position.x, cy = f.position.y, cz = f.position.z;
+	const float sx = f.size.x, sy = f.size.y, sz = f.size.z;
+	const float r2 = sx * sx;
+	const float invRadius = sx > 0 ? 1 / sx : 0;
+	const physx::PxU32 mask = f.mask;
+	
+	const bool sphere = f.shape == ForceField::SPHERE;
+	const bool box = f.shape == ForceField::BOX;
+	const bool linear = f.falloff == ForceField::LINEAR;
+	const bool inverseSquare = f.falloff == ForceField::INVERSE_SQUARE;
+	
+	// selects instead of branches on the body data, so the loop vectorizes
+	for (size_t i = begin; i < end; i++)
+	{
+		const float dx = X[i] - cx;
+		const float dy = Y[i] - cy;
+		const float dz = Z[i] - cz;
+		const float d2 = dx * dx + dy * dy + dz * dz;
+		const float len = sqrtf(d2);
+		
+		const float inGroup = (G[i] & mask) ? 1.0f : 0.0f;
+		const float inShape = sphere ? (d2 <= r2 ? 1.0f : 0.0f) : box ? (fabsf(dx) <= sx && fabsf(dy) <= sy && fabsf(dz) <= sz ? 1.0f : 0.0f) : 1.0f;
+		const float w = linear ? max(1 - len * invRadius, 0.0f) : inverseSquare ? min(r2 / max(d2, 1e-12f), 1.0f) : 1.0f;
+		
+		const float s = f.strength * inGroup * inShape * w;
+		T[i] |= s != 0;
+		
+		if (TYPE == ForceField::ATTRACTOR || TYPE == ForceField::RADIAL)
+		{
+			const float k = (TYPE == ForceField::ATTRACTOR ? -s : s) * (len > 0 ? 1 / len : 0);
+			AX[i] += dx * k;
+			AY[i] += dy * k;
+			AZ[i] += dz * k;
+		}
+		else if (TYPE == ForceField::VORTEX)
+		{
+			const float tx = f.axis.y * dz - f.axis.z * dy;
+			const float ty = f.axis.z * dx - f.axis.x * dz;
+			const float tz = f.axis.x * dy - f.axis.y * dx;
+			const float tl = sqrtf(tx * tx + ty * ty + tz * tz);
+			const float k = s * (tl > 0 ? 1 / tl : 0);
+			AX[i] += tx * k;
+			AY[i] += ty * k;
+			AZ[i] += tz * k;
+		}
+		else if (TYPE == ForceField::DRAG)
+		{
+			AX[i] -= vx[i] * s;
+			AY[i] -= vy[i] * s;
+			AZ[i] -= vz[i] * s;
+		}
+	}
+}
+
+void ForceFieldSystem::execute(size_t begin, size_t end)
+{
+	for (size_t i = begin; i < end; i++)
+	{
+		ax[i] = ay[i] = az[i] = 0;
+		touched[i] = 0;
+	}
+	
+	// field by field, so the type is resolved once per pass instead of per body
+	for (size_t k = 0; k < active.size(); k++)
+	{
+		const ForceField& f = active[k];
+		
+		if (f.type == ForceField::ATTRACTOR)
+			accumulate<ForceField::ATTRACTOR>(f, begin, end);
+		else if (f.type == ForceField::RADIAL)
+			accumulate<ForceField::RADIAL>(f, begin, end);
+		else if (f.type == ForceField::VORTEX)
+			accumulate<ForceField::VORTEX>(f, begin, end);
+		else if (f.type == ForceField::DRAG)
+			accumulate<ForceField::DRAG>(f, begin, end);
+	}
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+#include "ofxPhysXPoseCache.h"
+#include "ofxPhysXParallel.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// fields produce accelerations, so bodies react independently of their mass
+struct ForceField
+{
+	enum Type
+	{
+		ATTRACTOR,	// towards position
+		RADIAL,		// away from position
+		VORTEX,		// around axis through position
+		DRAG		// against the body's linear velocity
+	};
+	
+	enum Shape
+	{
+		SPHERE,		// radius = size.x
+		BOX,		// half extents = size, axis aligned
+		INFINITE
+	};
+	
+	enum Falloff
+	{
+		CONSTANT,
+		LINEAR,			// 1 at the center, 0 at size.x
+		INVERSE_SQUARE	// size.x^2 / d^2, clamped to 1 inside size.x
+	};
+	
+	ForceField() :
+		type(ATTRACTOR),
+		shape(INFINITE),
+		falloff(CONSTANT),
+		axis(0, 1, 0),
+		size(100, 100, 100),
+		strength(100),
+		mask(0xffffffff),
+		enabled(true)
+	{}
+	
+	static ForceField attractor(const ofVec3f& position, float strength, float radius = 0, Falloff falloff = CONSTANT);
+	static ForceField radial(const ofVec3f& position, float strength, float radius = 0, Falloff falloff = LINEAR);
+	static ForceField vortex(const ofVec3f& position, const ofVec3f& axis, float strength, float radius = 0, Falloff falloff = LINEAR);
+	static ForceField drag(const ofVec3f& position, const ofVec3f& halfExtents, float strength);
+	
+	Type type;
+	Shape shape;
+	Falloff falloff;
+	
+	ofVec3f position;
+	ofVec3f axis;
+	ofVec3f size;
+	
+	float strength;
+	
+	// affects bodies whose group has any of these bits
+	physx::PxU32 mask;
+	
+	bool enabled;
+};
+
+class ForceFieldSystem : protected ParallelJob
+{
+public:
+	
+	ForceFieldSystem() : multithreaded(true), needsVelocities(false) {}
+	
+	// ids stay valid until the field is removed
+	size_t add(const ForceField& field);
+	void remove(size_t id);
+	void clear();
+	
+	inline ForceField& get(size_t id) { return fields[id]; }
+	inline const ForceField& get(size_t id) const { return fields[id]; }
+	
+	inline bool empty() const { return fields.size() == freeIds.size(); }
+	
+	inline void setMultithreaded(bool yn) { multithreaded = yn; }
+	inline bool isMultithreaded() const { return multithreaded; }
+	
+	// evaluate all fields over the bodies that moved in the last step, skipping
+	// kinematic ones, and add the resulting accelerations; sleeping bodies are
+	// not woken. Called by World before each step.
+	void apply(const PoseCache& poses, physx::PxCpuDispatcher *dispatcher);
+	
+protected:
+	
+	void execute(size_t begin, size_t end);
+	
+	// one branch free pass of a field over the gathered bodies
+	template <int TYPE>
+	void accumulate(const ForceField& f, size_t begin, size_t end);
+	
+	vector<ForceField> fields;
+	vector<size_t> freeIds;
+	
+	// set for removed ids, enabled is left to the user
+	vector<unsigned char> freed;
+	
+	bool multithreaded;
+	
+	// per evaluation, the moving bodies gathered into SoA
+	vector<ForceField> active;
+	bool needsVelocities;
+	
+	vector<physx::PxRigidDynamic*> bodies;
+	vector<physx::PxU32> groups;
+	vector<float> px, py, pz;
+	vector<float> vx, vy, vz;
+	vector<float> ax, ay, az;
+	vector<unsigned char> touched;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,386 @@
+#include "ofxPhysXMeshCooker.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+const MeshCooker::Ticket MeshCooker::INVALID_TICKET;
+
+// FNV-1a, enough to tell meshes apart as file names
+static inline void hashBytes(physx::PxU64& h, const void *data, size_t size)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++)
+	{
+		h ^= p[i];
+		h *= 1099511628211ULL;
+	}
+}
+
+MeshCooker::MeshCooker() :
+	physics(NULL),
+	cooking(NULL),
+	cacheDirectory("physx_cache"),
+	nextTicket(1),
+	available(0, 0x7fffffff),
+	running(false),
+	cacheHits(0),
+	numCooked(0)
+{
+}
+
+MeshCooker::~MeshCooker()
+{
+	clear();
+}
+
+bool MeshCooker::setup(physx::PxFoundation& foundation, physx::PxPhysics& physics_)
+{
+	clear();
+	
+	physics = &physics_;
+	scale = physics->getTolerancesScale();
+	
+	if (!cacheDirectory.empty())
+		cacheDirectory = ofToDataPath(cacheDirectory, true);
+	
+	cooking = PxCreateCooking(PX_PHYSICS_VERSION, foundation, physx::PxCookingParams(scale));
+	if (!cooking)
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "PxCreateCooking failed";
+		physics = NULL;
+		return false;
+	}
+	
+	return true;
+}
+
+void MeshCooker::clear()
+{
+	if (running)
+	{
+		running = false;
+		available.set();
+		thread.join();
+	}
+	
+	map<Ticket, Job*>::iterator jt = jobs.begin();
+	while (jt != jobs.end())
+	{
+		delete jt->second;
+		jt++;
+	}
+	jobs.clear();
+	pending.clear();
+	
+	map<string, physx::PxBase*>::iterator it = meshes.begin();
+	while (it != meshes.end())
+	{
+		it->second->release();
+		it++;
+	}
+	meshes.clear();
+	
+	if (cooking)
+		cooking->release();
+	cooking = NULL;
+	
+	physics = NULL;
+}
+
+void MeshCooker::setCacheDirectory(const string& path)
+{
+	// resolved here, the worker thread shouldn't touch the data path
+	cacheDirectory = path.empty() ? "" : ofToDataPath(path, true);
+}
+
+physx::PxConvexMesh* MeshCooker::createConvexMesh(const ofMesh& mesh)
+{
+	Job job;
+	if (!prepare(mesh, CONVEX, job)) return NULL;
+	
+	physx::PxBase *result = create(job);
+	return result ? result->is<physx::PxConvexMesh>() : NULL;
+}
+
+physx::PxTriangleMesh* MeshCooker::createTriangleMesh(const ofMesh& mesh)
+{
+	Job job;
+	if (!prepare(mesh, TRIANGLE, job)) return NULL;
+	
+	physx::PxBase *result = create(job);
+	return result ? result->is<physx::PxTriangleMesh>() : NULL;
+}
+
+MeshCooker::Ticket MeshCooker::cookAsync(const ofMesh& mesh, Type type)
+{
+	if (!cooking)
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "call setup first";
+		return INVALID_TICKET;
+	}
+	
+	Job *job = new Job;
+	if (!prepare(mesh, type, *job))
+	{
+		delete job;
+		return INVALID_TICKET;
+	}
+	
+	if (!running)
+	{
+		running = true;
+		thread.setName("ofxPhysX::MeshCooker");
+		thread.start(*this);
+	}
+	
+	Ticket ticket;
+	{
+		Poco::FastMutex::ScopedLock lock(jobMutex);
+		ticket = nextTicket++;
+		jobs[ticket] = job;
+		pending.push_back(job);
+	}
+	
+	available.set();
+	return ticket;
+}
+
+bool MeshCooker::isReady(Ticket ticket) const
+{
+	Poco::FastMutex::ScopedLock lock(jobMutex);
+	
+	map<Ticket, Job*>::const_iterator it = jobs.find(ticket);
+	return it != jobs.end() && it->second->done.tryWait(0);
+}
+
+physx::PxConvexMesh* MeshCooker::getConvexMesh(Ticket ticket)
+{
+	physx::PxBase *result = finish(ticket, CONVEX);
+	return result ? result->is<physx::PxConvexMesh>() : NULL;
+}
+
+physx::PxTriangleMesh* MeshCooker::getTriangleMesh(Ticket ticket)
+{
+	physx::PxBase *result = finish(ticket, TRIANGLE);
+	return result ? result->is<physx::PxTriangleMesh>() : NULL;
+}
+
+//
+
+void MeshCooker::run()
+{
+	while (true)
+	{
+		available.wait();
+		if (!running) break;
+		
+		Job *job = NULL;
+		{
+			Poco::FastMutex::ScopedLock lock(jobMutex);
+			if (pending.empty()) continue;
+			
+			job = pending.front();
+			pending.pop_front();
+		}
+		
+		job->ok = cook(*job);
+		job->done.set();
+	}
+}
+
+bool MeshCooker::prepare(const ofMesh& mesh, Type type, Job& job) const
+{
+	if (mesh.getNumVertices() == 0)
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "empty mesh";
+		return false;
+	}
+	
+	if (type == TRIANGLE && mesh.getMode() != OF_PRIMITIVE_TRIANGLES)
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "triangle meshes need OF_PRIMITIVE_TRIANGLES";
+		return false;
+	}
+	
+	job.type = type;
+	
+	const vector<ofVec3f>& vertices = mesh.getVertices();
+	job.points.resize(vertices.size());
+	for (size_t i = 0; i < vertices.size(); i++)
+		toPx(vertices[i], job.points[i]);
+	
+	// convex hulls are computed from the points alone
+	if (type == TRIANGLE)
+	{
+		if (mesh.hasIndices())
+		{
+			const vector<ofIndexType>& indices = mesh.getIndices();
+			job.indices.assign(indices.begin(), indices.end());
+		}
+		else
+		{
+			job.indices.resize(vertices.size());
+			for (size_t i = 0; i < vertices.size(); i++)
+				job.indices[i] = i;
+		}
+		
+		job.indices.resize(job.indices.size() / 3 * 3);
+	}
+	
+	physx::PxU64 h = 14695981039346656037ULL;
+	const physx::PxU32 version = PX_PHYSICS_VERSION;
+	hashBytes(h, &type, sizeof(type));
+	hashBytes(h, &version, sizeof(version));
+	hashBytes(h, &scale.length, sizeof(scale.length));
+	hashBytes(h, &scale.speed, sizeof(scale.speed));
+	hashBytes(h, job.points.data(), job.points.size() * sizeof(physx::PxVec3));
+	hashBytes(h, job.indices.data(), job.indices.size() * sizeof(physx::PxU32));
+	
+	char buf[32];
+	snprintf(buf, sizeof(buf), "%016llx", (unsigned long long)h);
+	job.hash = buf;
+	
+	return true;
+}
+
+bool MeshCooker::cook(Job& job)
+{
+	const string path = getCachePath(job);
+	
+	if (!path.empty() && ofFile::doesFileExist(path, false))
+	{
+		ofBuffer buffer = ofBufferFromFile(path, true);
+		if (buffer.size() > 0)
+		{
+			job.cooked.assign(buffer.getBinaryBuffer(), buffer.getBinaryBuffer() + buffer.size());
+			cacheHits++;
+			return true;
+		}
+	}
+	
+	physx::PxDefaultMemoryOutputStream stream;
+	bool ok = false;
+	
+	{
+		Poco::FastMutex::ScopedLock lock(cookMutex);
+		
+		if (!cooking) return false;
+		
+		if (job.type == CONVEX)
+		{
+			physx::PxConvexMeshDesc desc;
+			desc.points.count = job.points.size();
+			desc.points.stride = sizeof(physx::PxVec3);
+			desc.points.data = job.points.data();
+			desc.flags = physx::PxConvexFlag::eCOMPUTE_CONVEX;
+			
+			ok = cooking->cookConvexMesh(desc, stream);
+		}
+		else
+		{
+			physx::PxTriangleMeshDesc desc;
+			desc.points.count = job.points.size();
+			desc.points.stride = sizeof(physx::PxVec3);
+			desc.points.data = job.points.data();
+			desc.triangles.count = job.indices.size() / 3;
+			desc.triangles.stride = sizeof(physx::PxU32) * 3;
+			desc.triangles.data = job.indices.data();
+			
+			ok = cooking->cookTriangleMesh(desc, stream);
+		}
+	}
+	
+	if (!ok) return false;
+	
+	job.cooked.assign(stream.getData(), stream.getData() + stream.getSize());
+	numCooked++;
+	
+	if (!path.empty())
+	{
+		ofDirectory::createDirectory(cacheDirectory, false, true);
+		
+		// write aside and rename, so a crash never leaves a truncated entry
+		const string tmp = path + ".tmp";
+		
+		ofBuffer buffer;
+		buffer.set((const char*)job.cooked.data(), job.cooked.size());
+		
+		if (ofBufferToFile(tmp, buffer, true))
+			rename(tmp.c_str(), path.c_str());
+	}
+	
+	return true;
+}
+
+physx::PxBase* MeshCooker::create(Job& job)
+{
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "call setup first";
+		return NULL;
+	}
+	
+	map<string, physx::PxBase*>::iterator it = meshes.find(job.hash);
+	if (it != meshes.end())
+		return it->second;
+	
+	if (job.cooked.empty() && !cook(job))
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "cooking failed";
+		return NULL;
+	}
+	
+	physx::PxDefaultMemoryInputData input(job.cooked.data(), job.cooked.size());
+	
+	physx::PxBase *result = NULL;
+	if (job.type == CONVEX)
+		result = physics->createConvexMesh(input);
+	else
+		result = physics->createTriangleMesh(input);
+	
+	if (!result)
+	{
+		ofLogError("ofxPhysX::MeshCooker") << "can't create a mesh from the cooked data";
+		return NULL;
+	}
+	
+	meshes[job.hash] = result;
+	return result;
+}
+
+physx::PxBase* MeshCooker::finish(Ticket ticket, Type type)
+{
+	Job *job = NULL;
+	{
+		Poco::FastMutex::ScopedLock lock(jobMutex);
+		
+		map<Ticket, Job*>::iterator it = jobs.find(ticket);
+		if (it == jobs.end()) return NULL;
+		
+		// the ticket stays valid for the right getter, the worker may still use the job
+		if (it->second->type != type)
+		{
+			ofLogError("ofxPhysX::MeshCooker") << "ticket " << ticket << " was queued as another mesh type";
+			return NULL;
+		}
+		
+		job = it->second;
+		jobs.erase(it);
+	}
+	
+	job->done.wait();
+	
+	physx::PxBase *result = job->ok ? create(*job) : NULL;
+	if (!job->ok)
+		ofLogError("ofxPhysX::MeshCooker") << "cooking failed";
+	
+	delete job;
+	return result;
+}
+
+string MeshCooker::getCachePath(const Job& job) const
+{
+	if (cacheDirectory.empty()) return "";
+	return ofFilePath::join(cacheDirectory, job.hash + (job.type == CONVEX ? ".convex" : ".trimesh"));
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+
+#include "Poco/Thread.h"
+#include "Poco/Runnable.h"
+#include "Poco/Mutex.h"
+#include "Poco/Semaphore.h"
+#include "Poco/Event.h"
+#include "Poco/AtomicCounter.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Cooks ofMesh into PhysX convex and triangle meshes. Cooked streams are cached
+// on disk under a hash of the vertices, indices and cooking parameters, so meshes
+// seen by an earlier run skip cooking. Meshes with the same content are created
+// once and shared. cookAsync() cooks on a background thread; the PhysX mesh itself
+// is created on the thread collecting the ticket.
+class MeshCooker : protected Poco::Runnable
+{
+public:
+	
+	enum Type
+	{
+		CONVEX,
+		TRIANGLE
+	};
+	
+	typedef physx::PxU32 Ticket;
+	static const Ticket INVALID_TICKET = 0;
+	
+	MeshCooker();
+	virtual ~MeshCooker();
+	
+	bool setup(physx::PxFoundation& foundation, physx::PxPhysics& physics);
+	void clear();
+	
+	// relative to the data folder, "" disables the disk cache
+	void setCacheDirectory(const string& path);
+	inline const string& getCacheDirectory() const { return cacheDirectory; }
+	
+	// cook or load now, NULL on failure; triangle meshes need OF_PRIMITIVE_TRIANGLES
+	physx::PxConvexMesh* createConvexMesh(const ofMesh& mesh);
+	physx::PxTriangleMesh* createTriangleMesh(const ofMesh& mesh);
+	
+	// the mesh is copied, so it can change right after the call
+	Ticket cookAsync(const ofMesh& mesh, Type type);
+	bool isReady(Ticket ticket) const;
+	
+	// wait for the ticket and create the mesh, which consumes the ticket
+	physx::PxConvexMesh* getConvexMesh(Ticket ticket);
+	physx::PxTriangleMesh* getTriangleMesh(Ticket ticket);
+	
+	inline size_t getNumCacheHits() const { return (size_t)cacheHits.value(); }
+	inline size_t getNumCooked() const { return (size_t)numCooked.value(); }
+	
+protected:
+	
+	struct Job
+	{
+		// done stays set once the worker finished, ok and cooked are valid after it
+		Job() : type(CONVEX), done(false), ok(false) {}
+		
+		Type type;
+		string hash;
+		vector<physx::PxVec3> points;
+		vector<physx::PxU32> indices;
+		
+		vector<physx::PxU8> cooked;
+		Poco::Event done;
+		bool ok;
+	};
+	
+	void run();
+	
+	bool prepare(const ofMesh& mesh, Type type, Job& job) const;
+	bool cook(Job& job);
+	physx::PxBase* create(Job& job);
+	physx::PxBase* finish(Ticket ticket, Type type);
+	
+	string getCachePath(const Job& job) const;
+	
+	physx::PxPhysics *physics;
+	physx::PxCooking *cooking;
+	physx::PxTolerancesScale scale;
+	
+	string cacheDirectory;
+	
+	// created meshes by content hash, one reference held each
+	map<string, physx::PxBase*> meshes;
+	
+	Poco::FastMutex cookMutex;
+	
+	mutable Poco::FastMutex jobMutex;
+	map<Ticket, Job*> jobs;
+	deque<Job*> pending;
+	Ticket nextTicket;
+	
+	Poco::Thread thread;
+	Poco::Semaphore available;
+	
+	// only written by the owner, the worker reads it after available.wait()
+	bool running;
+	
+	Poco::AtomicCounter cacheHits;
+	Poco::AtomicCounter numCooked;
+};
+
+OFX_PHYSX_END_NAMESPACE
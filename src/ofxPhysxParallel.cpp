@@ -0,0 +1,117 @@
+#include "ofxPhysXParallel.h"
+
+#include "Poco/AtomicCounter.h"
+#include "Poco/Event.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+namespace
+{
+	class ChunkBatch;
+	
+	class ChunkTask : public physx::PxBaseTask
+	{
+	public:
+		
+		ChunkTask() : batch(NULL) {}
+		
+		void run();
+		void release();
+		const char* getName() const { return "ofxPhysX::parallelFor"; }
+		
+		ChunkBatch *batch;
+	};
+	
+	// Chunks are claimed from a shared counter by whoever gets to them first, the
+	// calling thread included, so parallelFor() never waits on a task no thread is
+	// running. Tasks the dispatcher picks up late find no chunks left; the batch
+	// is reference counted so it outlives them.
+	class ChunkBatch
+	{
+	public:
+		
+		ChunkBatch(ParallelJob& job, size_t n, size_t numChunks) :
+			job(job),
+			n(n),
+			chunk((n + numChunks - 1) / numChunks),
+			numChunks(numChunks),
+			claimed(0),
+			completed(0),
+			refs(numChunks),
+			tasks(numChunks - 1)
+		{
+			for (size_t i = 0; i < tasks.size(); i++)
+				tasks[i].batch = this;
+		}
+		
+		// false once every chunk is claimed
+		bool runNext()
+		{
+			const size_t i = claimed++;
+			if (i >= numChunks) return false;
+			
+			const size_t begin = min(i * chunk, n);
+			job.execute(begin, min(begin + chunk, n));
+			
+			if (++completed == (int)numChunks)
+				done.set();
+			
+			return true;
+		}
+		
+		void unref()
+		{
+			if (--refs == 0)
+				delete this;
+		}
+		
+		ParallelJob& job;
+		const size_t n, chunk, numChunks;
+		
+		Poco::AtomicCounter claimed;
+		Poco::AtomicCounter completed;
+		Poco::AtomicCounter refs;
+		Poco::Event done;
+		
+		vector<ChunkTask> tasks;
+	};
+	
+	void ChunkTask::run()
+	{
+		while (batch->runNext()) {}
+	}
+	
+	void ChunkTask::release()
+	{
+		batch->unref();
+	}
+}
+
+void parallelFor(physx::PxCpuDispatcher *dispatcher, ParallelJob& job, size_t n, size_t grain)
+{
+	if (n == 0) return;
+	
+	size_t numChunks = 1;
+	if (dispatcher)
+		numChunks = min((size_t)dispatcher->getWorkerCount() + 1, (n + grain - 1) / grain);
+	
+	if (numChunks <= 1)
+	{
+		job.execute(0, n);
+		return;
+	}
+	
+	ChunkBatch *batch = new ChunkBatch(job, n, numChunks);
+	
+	for (size_t i = 0; i < batch->tasks.size(); i++)
+		dispatcher->submitTask(batch->tasks[i]);
+	
+	// the calling thread works through whatever is left, then waits only for
+	// chunks already running on other threads; safe to call from a worker
+	while (batch->runNext()) {}
+	batch->done.wait();
+	
+	batch->unref();
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+class ParallelJob
+{
+public:
+	virtual ~ParallelJob() {}
+	virtual void execute(size_t begin, size_t end) = 0;
+};
+
+// split [0, n) into chunks of at least grain items, run them on the dispatcher's
+// workers and the calling thread, returns when all chunks are done. The calling
+// thread runs any chunk not yet taken, so this also works from a worker thread or
+// with every worker busy. execute() may be called several times on one thread.
+void parallelFor(physx::PxCpuDispatcher *dispatcher, ParallelJob& job, size_t n, size_t grain = 256);
+
+OFX_PHYSX_END_NAMESPACE
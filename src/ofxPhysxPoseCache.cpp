@@ -0,0 +1,195 @@
+#include "ofxPhysXPoseCache.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+const physx::PxU32 PoseCache::INVALID_SLOT;
+const PoseCache::Handle PoseCache::INVALID_HANDLE;
+
+physx::PxU32 PoseCache::add(physx::PxRigidActor *actor)
+{
+	assert(actor);
+	
+	physx::PxU32 slot;
+	
+	if (!freeSlots.empty())
+	{
+		slot = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		slot = actors.size();
+		
+		if (slot >= MAX_SLOTS)
+		{
+			ofLogError("ofxPhysX::PoseCache") << "more than " << MAX_SLOTS << " actors";
+			return INVALID_SLOT;
+		}
+		
+		actors.push_back(NULL);
+		dynamics.push_back(NULL);
+		kinematics.push_back(0);
+		groups.push_back(0);
+		generations.push_back(1);
+		bindings.push_back(Binding());
+		shapes.push_back(NULL);
+		geometryTypes.push_back(physx::PxGeometryType::eINVALID);
+		numShapes.push_back(0);
+		positions.push_back(ofVec3f());
+		rotations.push_back(ofQuaternion());
+		transforms.push_back(ofMatrix4x4());
+		prevPositions.push_back(ofVec3f());
+		prevRotations.push_back(ofQuaternion());
+		skipped.push_back(0);
+	}
+	
+	actors[slot] = actor;
+	dynamics[slot] = actor->isRigidDynamic();
+	kinematics[slot] = dynamics[slot] && (dynamics[slot]->getRigidBodyFlags() & physx::PxRigidBodyFlag::eKINEMATIC);
+	groups[slot] = 1;
+	bindings[slot].owner = owner;
+	bindings[slot].handle = getHandle(slot);
+	actor->userData = &bindings[slot];
+	updateShape(slot);
+	
+	set(slot, actor->getGlobalPose());
+	prevPositions[slot] = positions[slot];
+	prevRotations[slot] = rotations[slot];
+	
+	return slot;
+}
+
+void PoseCache::remove(physx::PxRigidActor *actor)
+{
+	physx::PxU32 slot = getSlot(actor);
+	if (slot == INVALID_SLOT || slot >= actors.size() || actors[slot] != actor) return;
+	
+	actors[slot] = NULL;
+	dynamics[slot] = NULL;
+	kinematics[slot] = 0;
+	groups[slot] = 0;
+	shapes[slot] = NULL;
+	geometryTypes[slot] = physx::PxGeometryType::eINVALID;
+	numShapes[slot] = 0;
+	skipped[slot] = 0;
+	actor->userData = NULL;
+	bindings[slot].handle = INVALID_HANDLE;
+	
+	// stale handles to this slot stop resolving, 0 is never a generation
+	generations[slot] = generations[slot] < MAX_GENERATION ? generations[slot] + 1 : 1;
+	freeSlots.push_back(slot);
+}
+
+void PoseCache::updateShape(physx::PxU32 slot)
+{
+	physx::PxRigidActor *actor = actors[slot];
+	
+	physx::PxShape *shape = NULL;
+	numShapes[slot] = actor->getNbShapes();
+	actor->getShapes(&shape, 1);
+	
+	shapes[slot] = shape;
+	geometryTypes[slot] = shape ? shape->getGeometryType() : physx::PxGeometryType::eINVALID;
+}
+
+void PoseCache::clear()
+{
+	actors.clear();
+	dynamics.clear();
+	kinematics.clear();
+	groups.clear();
+	generations.clear();
+	bindings.clear();
+	shapes.clear();
+	geometryTypes.clear();
+	numShapes.clear();
+	positions.clear();
+	rotations.clear();
+	transforms.clear();
+	prevPositions.clear();
+	prevRotations.clear();
+	activeSlots.clear();
+	freeSlots.clear();
+	skipped.clear();
+	skippedSlots.clear();
+}
+
+void PoseCache::update(const physx::PxActiveTransform *active, physx::PxU32 numActive)
+{
+	// bodies that stopped moving don't blend anymore
+	for (size_t i = 0; i < activeSlots.size(); i++)
+	{
+		physx::PxU32 slot = activeSlots[i];
+		prevPositions[slot] = positions[slot];
+		prevRotations[slot] = rotations[slot];
+	}
+	
+	activeSlots.clear();
+	
+	for (physx::PxU32 i = 0; i < numActive; i++)
+	{
+		physx::PxU32 slot = getSlot(active[i].actor);
+		if (slot == INVALID_SLOT || slot >= actors.size()) continue;
+		
+		prevPositions[slot] = positions[slot];
+		prevRotations[slot] = rotations[slot];
+		
+		set(slot, active[i].actor2World);
+		activeSlots.push_back(slot);
+		skipped[slot] = 0;
+	}
+	
+	// moved in a skipped substep and came to rest, nothing to blend from
+	for (size_t i = 0; i < skippedSlots.size(); i++)
+	{
+		physx::PxU32 slot = skippedSlots[i];
+		if (!skipped[slot]) continue;
+		
+		skipped[slot] = 0;
+		teleport(slot, actors[slot]->getGlobalPose());
+	}
+	
+	skippedSlots.clear();
+}
+
+void PoseCache::skip(const physx::PxActiveTransform *active, physx::PxU32 numActive)
+{
+	for (physx::PxU32 i = 0; i < numActive; i++)
+	{
+		physx::PxU32 slot = getSlot(active[i].actor);
+		if (slot == INVALID_SLOT || slot >= actors.size() || skipped[slot]) continue;
+		
+		skipped[slot] = 1;
+		skippedSlots.push_back(slot);
+	}
+}
+
+ofMatrix4x4 PoseCache::getInterpolatedTransform(physx::PxU32 slot, float alpha) const
+{
+	if (alpha >= 1)
+		return transforms[slot];
+	
+	ofQuaternion q;
+	q.slerp(alpha, prevRotations[slot], rotations[slot]);
+	
+	ofMatrix4x4 m;
+	m.setTranslation(prevPositions[slot].getInterpolated(positions[slot], alpha));
+	m.setRotate(q);
+	return m;
+}
+
+void PoseCache::teleport(physx::PxU32 slot, const physx::PxTransform& pose)
+{
+	set(slot, pose);
+	prevPositions[slot] = positions[slot];
+	prevRotations[slot] = rotations[slot];
+}
+
+void PoseCache::set(physx::PxU32 slot, const physx::PxTransform& pose)
+{
+	toOF(pose.p, positions[slot]);
+	toOF(pose.q, rotations[slot]);
+	toOF(pose, transforms[slot]);
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Dense slot table of the rigid actors of a World. Each actor's userData points
+// to the Binding of its slot, holding the owner and the handle: the slot in the
+// low SLOT_BITS and a generation above, bumped when the slot is freed, so handles
+// to removed actors stop resolving even after the slot is reused.
+class PoseCache
+{
+public:
+	
+	PoseCache() : owner(NULL) {}
+	
+	static const physx::PxU32 INVALID_SLOT = 0xffffffff;
+	
+	typedef physx::PxU32 Handle;
+	static const Handle INVALID_HANDLE = 0;
+	
+	enum
+	{
+		SLOT_BITS = 20,
+		MAX_SLOTS = 1 << SLOT_BITS,
+		SLOT_MASK = MAX_SLOTS - 1,
+		MAX_GENERATION = (1 << (32 - SLOT_BITS)) - 1
+	};
+	
+	struct Binding
+	{
+		void *owner;
+		Handle handle;
+	};
+	
+	// the World, stored in the bindings of added actors
+	inline void setOwner(void *o) { owner = o; }
+	inline void* getOwner() const { return owner; }
+	
+	enum Kind
+	{
+		STATIC,
+		DYNAMIC,
+		KINEMATIC
+	};
+	
+	physx::PxU32 add(physx::PxRigidActor *actor);
+	void remove(physx::PxRigidActor *actor);
+	void clear();
+	
+	// refresh the cached shape after shapes were attached, detached or replaced
+	void updateShape(physx::PxU32 slot);
+	
+	// copy the active transforms of the last fetchResults
+	void update(const physx::PxActiveTransform *active, physx::PxU32 numActive);
+	
+	// remember the bodies moved by a substep whose transforms aren't copied, the
+	// next update() reads back the ones that stopped moving since
+	void skip(const physx::PxActiveTransform *active, physx::PxU32 numActive);
+	
+	inline size_t size() const { return actors.size(); }
+	
+	inline physx::PxRigidActor* getActor(physx::PxU32 slot) const { return actors[slot]; }
+	inline physx::PxRigidDynamic* getDynamic(physx::PxU32 slot) const { return dynamics[slot]; }
+	inline Kind getKind(physx::PxU32 slot) const { return kinematics[slot] ? KINEMATIC : dynamics[slot] ? DYNAMIC : STATIC; }
+	
+	// kept by World::setKinematic(), flags changed on the PhysX actor directly are missed
+	inline bool isKinematic(physx::PxU32 slot) const { return kinematics[slot] != 0; }
+	inline void setKinematic(physx::PxU32 slot, bool yn) { kinematics[slot] = yn && dynamics[slot]; }
+	
+	// the first shape and its geometry type, NULL and eINVALID without shapes
+	inline physx::PxShape* getShape(physx::PxU32 slot) const { return shapes[slot]; }
+	inline physx::PxGeometryType::Enum getGeometryType(physx::PxU32 slot) const { return geometryTypes[slot]; }
+	inline physx::PxU32 getNumShapes(physx::PxU32 slot) const { return numShapes[slot]; }
+	
+	inline Handle getHandle(physx::PxU32 slot) const { return (generations[slot] << SLOT_BITS) | slot; }
+	
+	inline bool isValid(Handle handle) const
+	{
+		const physx::PxU32 slot = handle & SLOT_MASK;
+		return handle != INVALID_HANDLE && slot < actors.size() && actors[slot] && generations[slot] == handle >> SLOT_BITS;
+	}
+	
+	// NULL once the actor was removed
+	inline physx::PxRigidActor* resolve(Handle handle) const { return isValid(handle) ? actors[handle & SLOT_MASK] : NULL; }
+	
+	// user group bits, 1 by default
+	inline physx::PxU32 getGroup(physx::PxU32 slot) const { return groups[slot]; }
+	inline void setGroup(physx::PxU32 slot, physx::PxU32 group) { groups[slot] = group; }
+	
+	inline const ofVec3f& getPosition(physx::PxU32 slot) const { return positions[slot]; }
+	inline const ofQuaternion& getRotate(physx::PxU32 slot) const { return rotations[slot]; }
+	inline const ofMatrix4x4& getTransform(physx::PxU32 slot) const { return transforms[slot]; }
+	
+	ofMatrix4x4 getInterpolatedTransform(physx::PxU32 slot, float alpha) const;
+	
+	// move without blending from the previous pose, e.g. after a restore
+	void teleport(physx::PxU32 slot, const physx::PxTransform& pose);
+	
+	// indexed by slot, free slots hold a NULL actor
+	inline const vector<physx::PxRigidActor*>& getActors() const { return actors; }
+	inline const vector<physx::PxRigidDynamic*>& getDynamics() const { return dynamics; }
+	inline const vector<physx::PxU32>& getGroups() const { return groups; }
+	inline const vector<unsigned char>& getKinematics() const { return kinematics; }
+	inline const vector<ofVec3f>& getPositions() const { return positions; }
+	inline const vector<ofQuaternion>& getRotations() const { return rotations; }
+	inline const vector<ofMatrix4x4>& getTransforms() const { return transforms; }
+	
+	// slots written by the last update
+	inline const vector<physx::PxU32>& getActiveSlots() const { return activeSlots; }
+	
+	static inline Handle getHandle(const physx::PxActor *actor) { return actor->userData ? ((const Binding*)actor->userData)->handle : INVALID_HANDLE; }
+	static inline void* getOwner(const physx::PxActor *actor) { return actor->userData ? ((const Binding*)actor->userData)->owner : NULL; }
+	static inline physx::PxU32 getSlot(Handle handle) { return handle != INVALID_HANDLE ? (handle & SLOT_MASK) : INVALID_SLOT; }
+	static inline physx::PxU32 getSlot(const physx::PxActor *actor) { return getSlot(getHandle(actor)); }
+	
+protected:
+	
+	void set(physx::PxU32 slot, const physx::PxTransform& pose);
+	
+	vector<physx::PxRigidActor*> actors;
+	vector<physx::PxRigidDynamic*> dynamics;
+	vector<unsigned char> kinematics;
+	vector<physx::PxU32> groups;
+	vector<physx::PxU32> generations;
+	
+	// a deque keeps the addresses held in userData stable as it grows
+	deque<Binding> bindings;
+	void *owner;
+	
+	vector<physx::PxShape*> shapes;
+	vector<physx::PxGeometryType::Enum> geometryTypes;
+	vector<physx::PxU32> numShapes;
+	
+	vector<ofVec3f> positions;
+	vector<ofQuaternion> rotations;
+	vector<ofMatrix4x4> transforms;
+	
+	vector<ofVec3f> prevPositions;
+	vector<ofQuaternion> prevRotations;
+	
+	vector<physx::PxU32> activeSlots;
+	vector<physx::PxU32> freeSlots;
+	
+	vector<unsigned char> skipped;
+	vector<physx::PxU32> skippedSlots;
+};
+
+OFX_PHYSX_END_NAMESPACE
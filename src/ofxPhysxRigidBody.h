@@ -16,7 +16,10 @@ public:
 	RigidBody(physx::PxActor *actor) : RigidActor_(NULL)
 	{
 		if (actor->isRigidBody())
+		{
 			this->rigid = (physx::PxRigidDynamic*)actor;
+			bind();
+		}
 		else
 			ofLogError("ofxPhysX", "invalid cast");
 	}
@@ -39,14 +42,43 @@ public:
 		return rigid->getMass();
 	}
 	
+	// see World::setKinematic()
+	inline RigidBody& setKinematic(bool yn = true)
+	{
+		if (world)
+			world->setKinematic(rigid, yn);
+		else
+			rigid->setRigidBodyFlag(physx::PxRigidBodyFlag::eKINEMATIC, yn);
+		return *this;
+	}
+	
+	inline bool isKinematic() const
+	{
+		return rigid->getRigidBodyFlags() & physx::PxRigidBodyFlag::eKINEMATIC;
+	}
+	
+	// staged until the next step, see World::setKinematicTargets()
+	inline RigidBody& setKinematicTarget(const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion())
+	{
+		if (world)
+			world->setKinematicTarget(handle, pos, rot);
+		else if (checkScene())
+			rigid->setKinematicTarget(physx::PxTransform(toPx(pos), toPx(rot)));
+		return *this;
+	}
+	
 	inline RigidBody& activate()
 	{
+		if (!checkScene()) return *this;
+		
 		rigid->wakeUp();
 		return *this;
 	}
 	
 	inline RigidBody& applyForce(const ofVec3f& force, bool is_local = false)
 	{
+		if (!checkScene()) return *this;
+		
 		physx::PxVec3 F;
 		
 		if (is_local)
@@ -61,6 +93,8 @@ public:
 	
 	inline RigidBody& applyForceImpulse(const ofVec3f& force, bool is_local = false)
 	{
+		if (!checkScene()) return *this;
+		
 		physx::PxVec3 F;
 		
 		if (is_local)
@@ -75,6 +109,8 @@ public:
 	
 	inline RigidBody& applyTorque(const ofVec3f& torque, bool is_local = false)
 	{
+		if (!checkScene()) return *this;
+		
 		physx::PxVec3 T;
 		
 		if (is_local)
@@ -98,6 +134,8 @@ public:
 	
 	inline RigidBody& applyTorqueImpulse(const ofVec3f& torque, bool is_local = false)
 	{
+		if (!checkScene()) return *this;
+		
 		physx::PxVec3 T;
 		
 		if (is_local)
@@ -121,16 +159,32 @@ public:
 
 	inline RigidBody& clearForce()
 	{
+		if (!checkScene()) return *this;
+		
 		rigid->clearForce(physx::PxForceMode::eFORCE);
 		return *this;
 	}
 	
 	inline RigidBody& clearTorque()
 	{
+		if (!checkScene()) return *this;
+		
 		rigid->clearTorque(physx::PxForceMode::eFORCE);
 		return *this;
 	}
 	
+protected:
+	
+	// PhysX only takes forces, wake ups and targets for bodies in a scene, a body
+	// added during a pipelined step joins it once the step is collected
+	inline bool checkScene() const
+	{
+		if (rigid->getScene()) return true;
+		
+		ofLogWarning("ofxPhysX::RigidBody") << "body isn't in the scene yet, call World::waitForSimulation() first";
+		return false;
+	}
+
 };
 
 OFX_PHYSX_END_NAMESPACE
\ No newline at end of file
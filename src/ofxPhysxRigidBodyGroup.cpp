@@ -0,0 +1,189 @@
+#include "ofxPhysXRigidBodyGroup.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+void RigidBodyGroup::add(const RigidBody& body)
+{
+	if (!body) return;
+	
+	worlds.push_back(body.getWorld());
+	handles.push_back(body.getHandle());
+	rigids.push_back(body.getRigid());
+}
+
+void RigidBodyGroup::add(const vector<physx::PxActor*>& actors)
+{
+	for (size_t i = 0; i < actors.size(); i++)
+		add(RigidBody(actors[i]));
+}
+
+void RigidBodyGroup::clear()
+{
+	worlds.clear();
+	handles.clear();
+	rigids.clear();
+}
+
+size_t RigidBodyGroup::compact()
+{
+	size_t n = 0;
+	
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		if (!resolve(i)) continue;
+		
+		worlds[n] = worlds[i];
+		handles[n] = handles[i];
+		rigids[n] = rigids[i];
+		n++;
+	}
+	
+	const size_t removed = worlds.size() - n;
+	
+	worlds.resize(n);
+	handles.resize(n);
+	rigids.resize(n);
+	
+	return removed;
+}
+
+void RigidBodyGroup::resolveAll()
+{
+	live.resize(worlds.size());
+	
+	for (size_t i = 0; i < live.size(); i++)
+		live[i] = resolve(i);
+}
+
+RigidBodyGroup& RigidBodyGroup::applyForces(const vector<ofVec3f>& forces, bool is_local)
+{
+	apply(forces, is_local, 1, false, physx::PxForceMode::eFORCE);
+	return *this;
+}
+
+RigidBodyGroup& RigidBodyGroup::applyForceImpulses(const vector<ofVec3f>& forces, bool is_local)
+{
+	apply(forces, is_local, 1, false, physx::PxForceMode::eIMPULSE);
+	return *this;
+}
+
+RigidBodyGroup& RigidBodyGroup::applyTorques(const vector<ofVec3f>& torques, bool is_local)
+{
+	apply(torques, is_local, WorldScale::getTorqueScale(), true, physx::PxForceMode::eFORCE);
+	return *this;
+}
+
+RigidBodyGroup& RigidBodyGroup::applyTorqueImpulses(const vector<ofVec3f>& torques, bool is_local)
+{
+	apply(torques, is_local, WorldScale::getTorqueScale(), true, physx::PxForceMode::eIMPULSE);
+	return *this;
+}
+
+void RigidBodyGroup::getPositions(vector<ofVec3f>& positions) const
+{
+	positions.resize(rigids.size());
+	
+	for (size_t i = 0; i < rigids.size(); i++)
+	{
+		physx::PxRigidDynamic *rigid = resolve(i);
+		
+		if (!rigid)
+			positions[i] = ofVec3f(0, 0, 0);
+		else if (worlds[i])
+			positions[i] = worlds[i]->getPoses().getPosition(PoseCache::getSlot(handles[i]));
+		else
+			positions[i] = toOF(rigid->getGlobalPose().p);
+	}
+}
+
+void RigidBodyGroup::apply(const vector<ofVec3f>& v, bool is_local, float scale, bool torque, physx::PxForceMode::Enum mode)
+{
+	if (rigids.empty()) return;
+	
+	if (v.size() != 1 && v.size() != rigids.size())
+	{
+		ofLogError("ofxPhysX::RigidBodyGroup") << "got " << v.size() << " vectors for " << rigids.size() << " bodies";
+		return;
+	}
+	
+	resolveAll();
+	transform(v, is_local, scale);
+	
+	const size_t n = live.size();
+	physx::PxRigidDynamic* const *r = live.data();
+	const physx::PxVec3 *f = result.data();
+	
+	// bodies still queued for the scene can't take forces yet
+	if (torque)
+	{
+		for (size_t i = 0; i < n; i++)
+			if (r[i] && r[i]->getScene()) r[i]->addTorque(f[i], mode);
+	}
+	else
+	{
+		for (size_t i = 0; i < n; i++)
+			if (r[i] && r[i]->getScene()) r[i]->addForce(f[i], mode);
+	}
+}
+
+void RigidBodyGroup::transform(const vector<ofVec3f>& v, bool is_local, float scale)
+{
+	const size_t n = rigids.size();
+	const size_t stride = v.size() == 1 ? 0 : 1;
+	
+	result.resize(n);
+	physx::PxVec3 *out = result.data();
+	
+	if (!is_local)
+	{
+		for (size_t i = 0; i < n; i++)
+		{
+			const ofVec3f& s = v[i * stride];
+			out[i] = physx::PxVec3(s.x * scale, s.y * scale, s.z * scale);
+		}
+		return;
+	}
+	
+	// gather the rotations into SoA so the rotate loop below vectorizes
+	qx.resize(n);
+	qy.resize(n);
+	qz.resize(n);
+	qw.resize(n);
+	
+	for (size_t i = 0; i < n; i++)
+	{
+		// identity for removed bodies, their result is skipped
+		ofVec4f q(0, 0, 0, 1);
+		if (live[i] && worlds[i])
+			q = worlds[i]->getPoses().getRotate(PoseCache::getSlot(handles[i]))._v;
+		else if (live[i])
+			q = toOF(live[i]->getGlobalPose().q)._v;
+		
+		qx[i] = q.x;
+		qy[i] = q.y;
+		qz[i] = q.z;
+		qw[i] = q.w;
+	}
+	
+	const float* PX_RESTRICT X = qx.data();
+	const float* PX_RESTRICT Y = qy.data();
+	const float* PX_RESTRICT Z = qz.data();
+	const float* PX_RESTRICT W = qw.data();
+	const ofVec3f* PX_RESTRICT src = v.data();
+	
+	// v' = v + w * t + q x t, t = 2 * (q x v)
+	for (size_t i = 0; i < n; i++)
+	{
+		const ofVec3f& s = src[i * stride];
+		
+		float tx = 2 * (Y[i] * s.z - Z[i] * s.y);
+		float ty = 2 * (Z[i] * s.x - X[i] * s.z);
+		float tz = 2 * (X[i] * s.y - Y[i] * s.x);
+		
+		out[i].x = (s.x + W[i] * tx + (Y[i] * tz - Z[i] * ty)) * scale;
+		out[i].y = (s.y + W[i] * ty + (Z[i] * tx - X[i] * tz)) * scale;
+		out[i].z = (s.z + W[i] * tz + (X[i] * ty - Y[i] * tx)) * scale;
+	}
+}
+
+OFX_PHYSX_END_NAMESPACE
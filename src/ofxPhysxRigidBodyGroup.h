@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+#include "ofxPhysXRigidBody.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+class RigidBodyGroup
+{
+public:
+	
+	RigidBodyGroup() {}
+	
+	void add(const RigidBody& body);
+	void add(const vector<physx::PxActor*>& actors);
+	void clear();
+	
+	inline size_t size() const { return rigids.size(); }
+	inline bool empty() const { return rigids.empty(); }
+	
+	// an invalid RigidBody once the body was removed from its World
+	inline RigidBody operator[](size_t i) const
+	{
+		physx::PxRigidDynamic *rigid = resolve(i);
+		return rigid ? RigidBody(rigid) : RigidBody();
+	}
+	
+	// Bodies removed from their World are skipped, their actors may already be
+	// reused by other bodies. compact() drops them and returns how many, which
+	// shifts the indices of per-body vectors.
+	size_t compact();
+	
+	// rotations for local vectors are read from the pose cache, forces and
+	// torques hold one entry for the whole group or one per body
+	RigidBodyGroup& applyForces(const vector<ofVec3f>& forces, bool is_local = false);
+	RigidBodyGroup& applyForceImpulses(const vector<ofVec3f>& forces, bool is_local = false);
+	RigidBodyGroup& applyTorques(const vector<ofVec3f>& torques, bool is_local = false);
+	RigidBodyGroup& applyTorqueImpulses(const vector<ofVec3f>& torques, bool is_local = false);
+	
+	// positions of the group from the pose cache, zero for removed bodies
+	void getPositions(vector<ofVec3f>& result) const;
+	
+protected:
+	
+	void apply(const vector<ofVec3f>& v, bool is_local, float scale, bool torque, physx::PxForceMode::Enum mode);
+	void transform(const vector<ofVec3f>& v, bool is_local, float scale);
+	
+	// NULL once the body was removed
+	inline physx::PxRigidDynamic* resolve(size_t i) const
+	{
+		if (!worlds[i]) return rigids[i];
+		
+		const PoseCache& poses = worlds[i]->getPoses();
+		return poses.isValid(handles[i]) ? poses.getDynamic(PoseCache::getSlot(handles[i])) : NULL;
+	}
+	
+	void resolveAll();
+	
+	vector<World*> worlds;
+	vector<PoseCache::Handle> handles;
+	
+	// only used for bodies outside a World, which have no handle to check
+	vector<physx::PxRigidDynamic*> rigids;
+	
+	// scratch, kept to avoid reallocating every frame
+	vector<physx::PxRigidDynamic*> live;
+	vector<float> qx, qy, qz, qw;
+	vector<physx::PxVec3> result;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -17,6 +17,7 @@ public:
 		if (actor->isRigidStatic())
 		{
 			this->rigid = (physx::PxRigidStatic*)actor;
+			bind();
 		}
 		else
 			ofLogError("ofxPhysX", "invalid cast");
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// masks select shapes by their World group bits
+
+struct QueryHit
+{
+	QueryHit() : actor(NULL), shape(NULL), distance(0), hit(false) {}
+	
+	physx::PxRigidActor *actor;
+	physx::PxShape *shape;
+	ofVec3f position;
+	ofVec3f normal;
+	float distance;
+	bool hit;
+	
+	inline operator bool() const { return hit; }
+};
+
+struct Raycast
+{
+	Raycast() : distance(PX_MAX_F32), mask(0xffffffff) {}
+	Raycast(const ofVec3f& origin, const ofVec3f& direction, float distance = PX_MAX_F32, physx::PxU32 mask = 0xffffffff)
+		: origin(origin), direction(direction), distance(distance), mask(mask) {}
+	
+	ofVec3f origin;
+	ofVec3f direction;
+	float distance;
+	physx::PxU32 mask;
+};
+
+struct Sweep
+{
+	Sweep() : distance(PX_MAX_F32), mask(0xffffffff) {}
+	Sweep(const physx::PxGeometry& geometry, const ofVec3f& position, const ofQuaternion& rotation, const ofVec3f& direction, float distance, physx::PxU32 mask = 0xffffffff)
+		: geometry(geometry), position(position), rotation(rotation), direction(direction), distance(distance), mask(mask) {}
+	
+	physx::PxGeometryHolder geometry;
+	ofVec3f position;
+	ofQuaternion rotation;
+	ofVec3f direction;
+	float distance;
+	physx::PxU32 mask;
+};
+
+struct Overlap
+{
+	Overlap() : mask(0xffffffff) {}
+	Overlap(const physx::PxGeometry& geometry, const ofVec3f& position, const ofQuaternion& rotation = ofQuaternion(), physx::PxU32 mask = 0xffffffff)
+		: geometry(geometry), position(position), rotation(rotation), mask(mask) {}
+	
+	physx::PxGeometryHolder geometry;
+	ofVec3f position;
+	ofQuaternion rotation;
+	physx::PxU32 mask;
+};
+
+// per thread state of World's batched queries
+
+struct BatchQueryContext
+{
+	enum { BATCH_SIZE = 256 };
+	
+	BatchQueryContext() : query(NULL) {}
+	
+	physx::PxBatchQuery *query;
+	
+	vector<physx::PxRaycastQueryResult> raycastResults;
+	vector<physx::PxSweepQueryResult> sweepResults;
+	vector<physx::PxOverlapQueryResult> overlapResults;
+	vector<physx::PxOverlapHit> overlapTouches;
+};
+
+OFX_PHYSX_END_NAMESPACE
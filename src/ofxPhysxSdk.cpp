@@ -0,0 +1,149 @@
+#include "ofxPhysXSdk.h"
+#include "ofxPhysXWorldScale.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+static physx::PxDefaultErrorCallback gDefaultErrorCallback;
+
+Sdk *Sdk::instance = NULL;
+int Sdk::refCount = 0;
+Poco::FastMutex Sdk::mutex;
+
+Sdk* Sdk::acquire(physx::PxAllocatorCallback& allocator, bool allocationTracking)
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	
+	if (!instance)
+	{
+		Sdk *sdk = new Sdk;
+		if (!sdk->create(allocator, allocationTracking))
+		{
+			delete sdk;
+			return NULL;
+		}
+		
+		instance = sdk;
+	}
+	else if (instance->worldScale != WorldScale::getWorldScale())
+	{
+		ofLogWarning("ofxPhysX::Sdk") << "the SDK was created with world scale " << instance->worldScale << ", set the scale before the first World";
+	}
+	
+	refCount++;
+	return instance;
+}
+
+void Sdk::release()
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	
+	assert(this == instance && refCount > 0);
+	
+	if (--refCount > 0) return;
+	
+	delete instance;
+	instance = NULL;
+}
+
+int Sdk::getRefCount()
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	return refCount;
+}
+
+void Sdk::keepMapping(MappedFile *file)
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	mappings.push_back(file);
+}
+
+Sdk::Sdk() :
+	foundation(NULL),
+	profileZoneManager(NULL),
+	cudaContextManager(NULL),
+	physics(NULL),
+	extensions(false),
+	worldScale(1)
+{
+}
+
+Sdk::~Sdk()
+{
+	destroy();
+}
+
+bool Sdk::create(physx::PxAllocatorCallback& allocator, bool allocationTracking)
+{
+	foundation = PxCreateFoundation(PX_PHYSICS_VERSION, allocator, gDefaultErrorCallback);
+	if (!foundation)
+	{
+		ofLogError("ofxPhysX::Sdk") << "PxCreateFoundation failed";
+		return false;
+	}
+	
+	foundation->setReportAllocationNames(allocationTracking);
+	
+	profileZoneManager = &physx::PxProfileZoneManager::createProfileZoneManager(foundation);
+	
+	physx::PxCudaContextManagerDesc cudaContextManagerDesc;
+	cudaContextManager = physx::PxCreateCudaContextManager(*foundation, cudaContextManagerDesc, profileZoneManager);
+	
+	if (cudaContextManager && !cudaContextManager->contextIsValid())
+	{
+		cudaContextManager->release();
+		cudaContextManager = NULL;
+	}
+	
+	worldScale = WorldScale::getWorldScale();
+	
+	physx::PxTolerancesScale scale;
+	scale.length = worldScale;
+	scale.mass = 1000;
+	scale.speed = scale.length * 10;
+	
+	physics = PxCreatePhysics(PX_PHYSICS_VERSION, *foundation, scale, allocationTracking, profileZoneManager);
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::Sdk") << "PxCreatePhysics failed";
+		return false;
+	}
+	
+	extensions = PxInitExtensions(*physics);
+	if (!extensions)
+	{
+		ofLogError("ofxPhysX::Sdk") << "PxInitExtensions failed";
+		return false;
+	}
+	
+	return true;
+}
+
+void Sdk::destroy()
+{
+	if (extensions)
+		PxCloseExtensions();
+	extensions = false;
+	
+	if (physics)
+		physics->release();
+	physics = NULL;
+	
+	// loaded objects live in the mappings, so these go after the SDK
+	for (size_t i = 0; i < mappings.size(); i++)
+		delete mappings[i];
+	mappings.clear();
+	
+	if (cudaContextManager)
+		cudaContextManager->release();
+	cudaContextManager = NULL;
+	
+	if (profileZoneManager)
+		profileZoneManager->release();
+	profileZoneManager = NULL;
+	
+	if (foundation)
+		foundation->release();
+	foundation = NULL;
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXSnapshot.h"
+
+#include "Poco/Mutex.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// The foundation, profile zone manager, CUDA context and PxPhysics, which PhysX
+// allows once per process. Every World acquires it in setup() and releases it in
+// clear(), the last release tears the SDK down. Allocation tracking and the
+// tolerances scale (WorldScale) are taken from the first acquire.
+class Sdk
+{
+public:
+	
+	static Sdk* acquire(physx::PxAllocatorCallback& allocator, bool allocationTracking);
+	void release();
+	
+	// number of Worlds holding the SDK
+	static int getRefCount();
+	
+	inline physx::PxFoundation& getFoundation() const { return *foundation; }
+	inline physx::PxPhysics& getPhysics() const { return *physics; }
+	inline physx::PxProfileZoneManager* getProfileZoneManager() const { return profileZoneManager; }
+	
+	// NULL without a usable CUDA device
+	inline physx::PxCudaContextManager* getCudaContextManager() const { return cudaContextManager; }
+	
+	// objects deserialized from a snapshot live in its mapping and may outlive the
+	// World that loaded it, so the mapping is closed after the SDK is released
+	void keepMapping(MappedFile *file);
+	
+protected:
+	
+	Sdk();
+	~Sdk();
+	
+	bool create(physx::PxAllocatorCallback& allocator, bool allocationTracking);
+	void destroy();
+	
+	physx::PxFoundation *foundation;
+	physx::PxProfileZoneManager *profileZoneManager;
+	physx::PxCudaContextManager *cudaContextManager;
+	physx::PxPhysics *physics;
+	bool extensions;
+	
+	float worldScale;
+	vector<MappedFile*> mappings;
+	
+	static Sdk *instance;
+	static int refCount;
+	static Poco::FastMutex mutex;
+	
+private:
+	
+	Sdk(const Sdk&);
+	Sdk& operator=(const Sdk&);
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,452 @@
+#include "ofxPhysXShapeRenderer.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+static const char *gInstancedVertexShader =
+	"#version 120\n"
+	"#extension GL_ARB_draw_instanced : enable\n"
+	"attribute mat4 instanceMatrix;\n"
+	"uniform vec4 color;\n"
+	"varying vec4 diffuse;\n"
+	"void main()\n"
+	"{\n"
+	"	vec3 n = normalize(gl_NormalMatrix * (mat3(instanceMatrix) * gl_Normal));\n"
+	"	diffuse = vec4(color.rgb * (0.3 + 0.7 * abs(n.z)), color.a);\n"
+	"	gl_Position = gl_ModelViewProjectionMatrix * (instanceMatrix * gl_Vertex);\n"
+	"}\n";
+
+static const char *gInstancedFragmentShader =
+	"#version 120\n"
+	"varying vec4 diffuse;\n"
+	"void main()\n"
+	"{\n"
+	"	gl_FragColor = diffuse;\n"
+	"}\n";
+
+ShapeRenderer::ShapeRenderer() : resolution(8), planeSize(10000)
+{
+	for (int i = 0; i < physx::PxGeometryType::eGEOMETRY_COUNT; i++)
+		colors[i].set(0.8, 0.8, 0.8);
+	
+	colors[physx::PxGeometryType::eSPHERE].set(0.9, 0.5, 0.3);
+	colors[physx::PxGeometryType::eBOX].set(0.3, 0.6, 0.9);
+	colors[physx::PxGeometryType::eCAPSULE].set(0.5, 0.9, 0.4);
+	colors[physx::PxGeometryType::ePLANE].set(0.3, 0.3, 0.3);
+}
+
+void ShapeRenderer::setResolution(int res)
+{
+	resolution = max(res, 2);
+	clear();
+}
+
+void ShapeRenderer::setPlaneSize(float size)
+{
+	planeSize = size;
+	clear();
+}
+
+void ShapeRenderer::setColor(physx::PxGeometryType::Enum type, const ofFloatColor& color)
+{
+	colors[type] = color;
+}
+
+void ShapeRenderer::invalidate()
+{
+	for (size_t i = 0; i < entries.size(); i++)
+		entries[i].dirty = true;
+}
+
+void ShapeRenderer::invalidate(physx::PxU32 slot)
+{
+	if (slot < entries.size())
+		entries[slot].dirty = true;
+}
+
+void ShapeRenderer::update(const PoseCache& poses, float alpha)
+{
+	for (size_t i = 0; i < groups.size(); i++)
+		groups[i].instances.clear();
+	
+	for (size_t i = poses.size(); i < entries.size(); i++)
+		releaseShapes(entries[i]);
+	
+	entries.resize(poses.size());
+	
+	// changed entries let go of their groups first, so a mesh released and
+	// recreated at the same address never matches its old group
+	for (physx::PxU32 slot = 0; slot < poses.size(); slot++)
+	{
+		Entry& entry = entries[slot];
+		const PoseCache::Handle handle = poses.getActor(slot) ? poses.getHandle(slot) : PoseCache::INVALID_HANDLE;
+		
+		if (entry.dirty || entry.handle != handle)
+		{
+			releaseShapes(entry);
+			entry.handle = handle;
+			entry.dirty = true;
+		}
+	}
+	
+	for (physx::PxU32 slot = 0; slot < poses.size(); slot++)
+	{
+		physx::PxRigidActor *actor = poses.getActor(slot);
+		if (!actor) continue;
+		
+		Entry& entry = entries[slot];
+		if (entry.dirty)
+			rebuild(entry, actor);
+		
+		const ofMatrix4x4 m = alpha < 1 ? poses.getInterpolatedTransform(slot, alpha) : poses.getTransform(slot);
+		
+		for (size_t i = 0; i < entry.shapes.size(); i++)
+		{
+			const ShapeInstance& s = entry.shapes[i];
+			groups[s.group].instances.push_back(s.local * m);
+		}
+	}
+}
+
+void ShapeRenderer::draw()
+{
+	if (!shader.isLoaded())
+	{
+		shader.setupShaderFromSource(GL_VERTEX_SHADER, gInstancedVertexShader);
+		shader.setupShaderFromSource(GL_FRAGMENT_SHADER, gInstancedFragmentShader);
+		shader.linkProgram();
+	}
+	
+	shader.begin();
+	
+	// a mat4 attribute takes four consecutive vec4 locations
+	GLint loc = shader.getAttributeLocation("instanceMatrix");
+	
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		Group& g = groups[i];
+		if (g.instances.empty()) continue;
+		
+		if (!g.instanceVbo)
+			glGenBuffers(1, &g.instanceVbo);
+		
+		glBindBuffer(GL_ARRAY_BUFFER, g.instanceVbo);
+		
+		if (g.instances.size() > g.capacity)
+			g.capacity = max(g.instances.size(), g.capacity * 2);
+		
+		glBufferData(GL_ARRAY_BUFFER, g.capacity * sizeof(ofMatrix4x4), NULL, GL_STREAM_DRAW);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, g.instances.size() * sizeof(ofMatrix4x4), g.instances[0].getPtr());
+		
+		for (int k = 0; k < 4; k++)
+		{
+			glEnableVertexAttribArray(loc + k);
+			glVertexAttribPointer(loc + k, 4, GL_FLOAT, GL_FALSE, sizeof(ofMatrix4x4), (const GLvoid*)(sizeof(float) * 4 * k));
+			glVertexAttribDivisorARB(loc + k, 1);
+		}
+		
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		
+		const ofFloatColor& c = colors[g.type];
+		shader.setUniform4f("color", c.r, c.g, c.b, c.a);
+		
+		g.mesh.drawInstanced(OF_MESH_FILL, g.instances.size());
+		
+		for (int k = 0; k < 4; k++)
+		{
+			glVertexAttribDivisorARB(loc + k, 0);
+			glDisableVertexAttribArray(loc + k);
+		}
+	}
+	
+	shader.end();
+}
+
+void ShapeRenderer::clear()
+{
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		Group& g = groups[i];
+		g.mesh.getVbo().clear();
+		
+		if (g.instanceVbo)
+			glDeleteBuffers(1, &g.instanceVbo);
+		g.instanceVbo = 0;
+		g.capacity = 0;
+	}
+	
+	groups.clear();
+	freeGroups.clear();
+	entries.clear();
+}
+
+void ShapeRenderer::release()
+{
+	clear();
+	shader.unload();
+}
+
+//
+
+void ShapeRenderer::rebuild(Entry& entry, physx::PxRigidActor *actor)
+{
+	releaseShapes(entry);
+	entry.dirty = false;
+	
+	const physx::PxU32 n = actor->getNbShapes();
+	vector<physx::PxShape*> shapes(n);
+	actor->getShapes(shapes.data(), n);
+	
+	for (physx::PxU32 i = 0; i < n; i++)
+	{
+		physx::PxShape *shape = shapes[i];
+		ofMatrix4x4 local = toOF(shape->getLocalPose());
+		
+		physx::PxGeometryType::Enum t = shape->getGeometryType();
+		if (t == physx::PxGeometryType::eSPHERE)
+		{
+			physx::PxSphereGeometry g;
+			shape->getSphereGeometry(g);
+			addShape(entry, t, WHOLE, NULL, ofMatrix4x4::newScaleMatrix(g.radius, g.radius, g.radius) * local);
+		}
+		else if (t == physx::PxGeometryType::eBOX)
+		{
+			physx::PxBoxGeometry g;
+			shape->getBoxGeometry(g);
+			addShape(entry, t, WHOLE, NULL, ofMatrix4x4::newScaleMatrix(toOF(g.halfExtents * 2)) * local);
+		}
+		else if (t == physx::PxGeometryType::eCAPSULE)
+		{
+			// the tube only scales across its axis uniformly, so its normals hold
+			physx::PxCapsuleGeometry g;
+			shape->getCapsuleGeometry(g);
+			
+			const ofMatrix4x4 cap = ofMatrix4x4::newScaleMatrix(g.radius, g.radius, g.radius);
+			addShape(entry, t, CAPSULE_TUBE, NULL, ofMatrix4x4::newScaleMatrix(g.halfHeight, g.radius, g.radius) * local);
+			addShape(entry, t, CAPSULE_CAP, NULL, cap * ofMatrix4x4::newTranslationMatrix(g.halfHeight, 0, 0) * local);
+			addShape(entry, t, CAPSULE_CAP, NULL, cap * ofMatrix4x4::newTranslationMatrix(-g.halfHeight, 0, 0) * local);
+		}
+		else if (t == physx::PxGeometryType::ePLANE)
+		{
+			addShape(entry, t, WHOLE, NULL, local);
+		}
+		else if (t == physx::PxGeometryType::eCONVEXMESH)
+		{
+			// one mesh per PxConvexMesh, the geometry scale goes in the instance matrix
+			physx::PxConvexMeshGeometry g;
+			shape->getConvexMeshGeometry(g);
+			addShape(entry, t, WHOLE, g.convexMesh, getScaleMatrix(g.scale) * local);
+		}
+		else if (t == physx::PxGeometryType::eTRIANGLEMESH)
+		{
+			physx::PxTriangleMeshGeometry g;
+			shape->getTriangleMeshGeometry(g);
+			addShape(entry, t, WHOLE, g.triangleMesh, getScaleMatrix(g.scale) * local);
+		}
+	}
+}
+
+void ShapeRenderer::addShape(Entry& entry, physx::PxGeometryType::Enum type, Part part, const physx::PxBase *source, const ofMatrix4x4& local)
+{
+	ShapeInstance s;
+	s.group = getGroup(type, part, source);
+	s.local = local;
+	
+	groups[s.group].refs++;
+	entry.shapes.push_back(s);
+}
+
+void ShapeRenderer::releaseShapes(Entry& entry)
+{
+	for (size_t i = 0; i < entry.shapes.size(); i++)
+	{
+		const size_t k = entry.shapes[i].group;
+		if (--groups[k].refs == 0)
+			dropGroup(k);
+	}
+	
+	entry.shapes.clear();
+}
+
+size_t ShapeRenderer::getGroup(physx::PxGeometryType::Enum type, Part part, const physx::PxBase *source)
+{
+	for (size_t i = 0; i < groups.size(); i++)
+	{
+		const Group& g = groups[i];
+		if (g.type == type && g.part == part && g.source == source)
+			return i;
+	}
+	
+	size_t i;
+	if (!freeGroups.empty())
+	{
+		i = freeGroups.back();
+		freeGroups.pop_back();
+	}
+	else
+	{
+		i = groups.size();
+		groups.push_back(Group());
+	}
+	
+	Group& g = groups[i];
+	g.type = type;
+	g.part = part;
+	g.source = source;
+	g.mesh = createMesh(type, part, source);
+	
+	return i;
+}
+
+void ShapeRenderer::dropGroup(size_t i)
+{
+	// called while drawing, so the GL buffers can go right away
+	Group& g = groups[i];
+	g.type = physx::PxGeometryType::eINVALID;
+	g.source = NULL;
+	g.instances.clear();
+	g.mesh.clear();
+	g.mesh.getVbo().clear();
+	
+	if (g.instanceVbo)
+		glDeleteBuffers(1, &g.instanceVbo);
+	g.instanceVbo = 0;
+	g.capacity = 0;
+	
+	freeGroups.push_back(i);
+}
+
+ofMatrix4x4 ShapeRenderer::getScaleMatrix(const physx::PxMeshScale& scale)
+{
+	// PhysX scales along the axes of scale.rotation
+	const ofQuaternion q = toOF(scale.rotation);
+	return ofMatrix4x4::newRotationMatrix(q) * ofMatrix4x4::newScaleMatrix(toOF(scale.scale)) * ofMatrix4x4::newRotationMatrix(q.inverse());
+}
+
+ofMesh ShapeRenderer::createMesh(physx::PxGeometryType::Enum type, Part part, const physx::PxBase *source) const
+{
+	if (type == physx::PxGeometryType::eSPHERE || part == CAPSULE_CAP)
+	{
+		return ofMesh::sphere(1, resolution * 2);
+	}
+	else if (type == physx::PxGeometryType::eBOX)
+	{
+		return ofMesh::box(1, 1, 1, 1, 1, 1);
+	}
+	else if (type == physx::PxGeometryType::ePLANE)
+	{
+		// PxPlaneGeometry is the x >= 0 half space, draw a quad facing +x
+		float s = planeSize / 2;
+		
+		ofMesh mesh;
+		mesh.setMode(OF_PRIMITIVE_TRIANGLE_STRIP);
+		mesh.addVertex(ofVec3f(0, -s, -s));
+		mesh.addVertex(ofVec3f(0, s, -s));
+		mesh.addVertex(ofVec3f(0, -s, s));
+		mesh.addVertex(ofVec3f(0, s, s));
+		for (int i = 0; i < 4; i++)
+			mesh.addNormal(ofVec3f(1, 0, 0));
+		return mesh;
+	}
+	else if (type == physx::PxGeometryType::eCAPSULE)
+	{
+		// open tube along x from -1 to 1, the caps are spheres
+		const int cols = resolution * 2 + 1;
+		
+		ofMesh mesh;
+		mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+		
+		for (int j = 0; j < 2; j++)
+		{
+			for (int i = 0; i < cols; i++)
+			{
+				float theta = TWO_PI * i / (cols - 1);
+				ofVec3f n(0, cos(theta), sin(theta));
+				mesh.addNormal(n);
+				mesh.addVertex(n + ofVec3f(j == 0 ? 1 : -1, 0, 0));
+			}
+		}
+		
+		for (int i = 0; i < cols - 1; i++)
+		{
+			ofIndexType i0 = i;
+			ofIndexType i1 = i0 + 1;
+			ofIndexType i2 = i0 + cols;
+			ofIndexType i3 = i2 + 1;
+			
+			mesh.addTriangle(i0, i2, i1);
+			mesh.addTriangle(i1, i2, i3);
+		}
+		
+		return mesh;
+	}
+	else if (type == physx::PxGeometryType::eCONVEXMESH)
+	{
+		// fan out each hull polygon, flat shaded
+		const physx::PxConvexMesh *convex = static_cast<const physx::PxConvexMesh*>(source);
+		const physx::PxVec3 *vertices = convex->getVertices();
+		const physx::PxU8 *indices = convex->getIndexBuffer();
+		
+		ofMesh mesh;
+		mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+		
+		for (physx::PxU32 i = 0; i < convex->getNbPolygons(); i++)
+		{
+			physx::PxHullPolygon poly;
+			convex->getPolygonData(i, poly);
+			
+			const ofVec3f n(poly.mPlane[0], poly.mPlane[1], poly.mPlane[2]);
+			const physx::PxU8 *p = indices + poly.mIndexBase;
+			
+			for (physx::PxU16 k = 2; k < poly.mNbVerts; k++)
+			{
+				mesh.addVertex(toOF(vertices[p[0]]));
+				mesh.addVertex(toOF(vertices[p[k - 1]]));
+				mesh.addVertex(toOF(vertices[p[k]]));
+				mesh.addNormal(n);
+				mesh.addNormal(n);
+				mesh.addNormal(n);
+			}
+		}
+		
+		return mesh;
+	}
+	else if (type == physx::PxGeometryType::eTRIANGLEMESH)
+	{
+		const physx::PxTriangleMesh *triangles = static_cast<const physx::PxTriangleMesh*>(source);
+		const physx::PxVec3 *vertices = triangles->getVertices();
+		const bool shortIndices = triangles->has16BitTriangleIndices();
+		
+		ofMesh mesh;
+		mesh.setMode(OF_PRIMITIVE_TRIANGLES);
+		
+		for (physx::PxU32 i = 0; i < triangles->getNbTriangles(); i++)
+		{
+			physx::PxU32 v[3];
+			for (int k = 0; k < 3; k++)
+			{
+				if (shortIndices)
+					v[k] = ((const physx::PxU16*)triangles->getTriangles())[i * 3 + k];
+				else
+					v[k] = ((const physx::PxU32*)triangles->getTriangles())[i * 3 + k];
+			}
+			
+			const ofVec3f p0 = toOF(vertices[v[0]]);
+			const ofVec3f p1 = toOF(vertices[v[1]]);
+			const ofVec3f p2 = toOF(vertices[v[2]]);
+			const ofVec3f n = (p1 - p0).cross(p2 - p0).normalize();
+			
+			mesh.addVertex(p0);
+			mesh.addVertex(p1);
+			mesh.addVertex(p2);
+			mesh.addNormal(n);
+			mesh.addNormal(n);
+			mesh.addNormal(n);
+		}
+		
+		return mesh;
+	}
+	
+	return ofMesh();
+}
+
+OFX_PHYSX_END_NAMESPACE
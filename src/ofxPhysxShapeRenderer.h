@@ -0,0 +1,106 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXHelper.h"
+#include "ofxPhysXPoseCache.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+class ShapeRenderer
+{
+public:
+	
+	ShapeRenderer();
+	
+	void setResolution(int res);
+	void setPlaneSize(float size);
+	void setColor(physx::PxGeometryType::Enum type, const ofFloatColor& color);
+	
+	// shapes are cached per slot, call these after changing an actor's geometry
+	void invalidate();
+	void invalidate(physx::PxU32 slot);
+	
+	// gather per-instance transforms from the pose cache, blended by alpha < 1
+	void update(const PoseCache& poses, float alpha = 1);
+	
+	// one instanced draw call per group
+	void draw();
+	
+	// drop all groups and cached shapes and their GL buffers, e.g. when the
+	// meshes they were built from are released
+	void clear();
+	
+	// clear() and unload the shader, not done on destruction which may outlive
+	// the GL context
+	void release();
+	
+	inline size_t getNumGroups() const { return groups.size() - freeGroups.size(); }
+	
+protected:
+	
+	// capsules are a stretched tube and two spheres, so any size shares the groups
+	enum Part
+	{
+		WHOLE,
+		CAPSULE_TUBE,
+		CAPSULE_CAP
+	};
+	
+	// unit sized geometry scaled per instance, or one mesh per PhysX mesh;
+	// dropped when the last shape using it goes
+	struct Group
+	{
+		Group() : type(physx::PxGeometryType::eINVALID), part(WHOLE), source(NULL), refs(0), instanceVbo(0), capacity(0) {}
+		
+		physx::PxGeometryType::Enum type;
+		Part part;
+		
+		// PxConvexMesh or PxTriangleMesh for mesh shapes
+		const physx::PxBase *source;
+		size_t refs;
+		
+		ofVboMesh mesh;
+		vector<ofMatrix4x4> instances;
+		
+		GLuint instanceVbo;
+		size_t capacity;
+	};
+	
+	struct ShapeInstance
+	{
+		size_t group;
+		ofMatrix4x4 local;
+	};
+	
+	struct Entry
+	{
+		Entry() : handle(PoseCache::INVALID_HANDLE), dirty(true) {}
+		
+		// compared to the slot's handle, pooled actors come back under a new one
+		PoseCache::Handle handle;
+		vector<ShapeInstance> shapes;
+		bool dirty;
+	};
+	
+	void rebuild(Entry& entry, physx::PxRigidActor *actor);
+	void addShape(Entry& entry, physx::PxGeometryType::Enum type, Part part, const physx::PxBase *source, const ofMatrix4x4& local);
+	void releaseShapes(Entry& entry);
+	size_t getGroup(physx::PxGeometryType::Enum type, Part part = WHOLE, const physx::PxBase *source = NULL);
+	void dropGroup(size_t i);
+	
+	ofMesh createMesh(physx::PxGeometryType::Enum type, Part part, const physx::PxBase *source) const;
+	
+	static ofMatrix4x4 getScaleMatrix(const physx::PxMeshScale& scale);
+	
+	int resolution;
+	float planeSize;
+	ofFloatColor colors[physx::PxGeometryType::eGEOMETRY_COUNT];
+	
+	vector<Group> groups;
+	vector<size_t> freeGroups;
+	vector<Entry> entries;
+	
+	ofShader shader;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,127 @@
+#include "ofxPhysXSnapshot.h"
+
+#ifndef TARGET_WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+static const char SNAPSHOT_MAGIC[8] = { 'o', 'f', 'x', 'P', 'h', 'y', 'X', 0 };
+
+SnapshotHeader::SnapshotHeader() : version(VERSION), physxVersion(PX_PHYSICS_VERSION), numActors(0), reserved(0), dataSize(0)
+{
+	memcpy(magic, SNAPSHOT_MAGIC, sizeof(magic));
+}
+
+bool SnapshotHeader::isValid(size_t fileSize) const
+{
+	if (memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0) return false;
+	if (version != VERSION) return false;
+	
+	// binary collections only load into the SDK version that wrote them
+	if (physxVersion != PX_PHYSICS_VERSION) return false;
+	
+	return fileSize >= SNAPSHOT_ALIGNMENT && dataSize <= fileSize - SNAPSHOT_ALIGNMENT;
+}
+
+//
+
+MappedFile::MappedFile() : data(NULL), length(0)
+#ifdef TARGET_WIN32
+	, file(INVALID_HANDLE_VALUE), mapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef TARGET_WIN32
+
+bool MappedFile::open(const string& path)
+{
+	close();
+	
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+	
+	mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+	if (!mapping)
+	{
+		close();
+		return false;
+	}
+	
+	data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (!data)
+	{
+		close();
+		return false;
+	}
+	
+	length = size.QuadPart;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data) UnmapViewOfFile(data);
+	data = NULL;
+	length = 0;
+	
+	if (mapping) CloseHandle(mapping);
+	mapping = NULL;
+	
+	if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+	file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const string& path)
+{
+	close();
+	
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) return false;
+	
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		::close(fd);
+		return false;
+	}
+	
+	// private mapping, pages PhysX writes to are copied and never reach the file
+	void *p = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	
+	if (p == MAP_FAILED) return false;
+	
+	data = p;
+	length = st.st_size;
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (data) munmap(data, length);
+	data = NULL;
+	length = 0;
+}
+
+#endif
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Snapshot file layout: a SNAPSHOT_ALIGNMENT byte header followed by a PhysX
+// binary collection, so the collection stays 128 byte aligned when mapped.
+struct SnapshotHeader
+{
+	enum
+	{
+		VERSION = 1,
+		SNAPSHOT_ALIGNMENT = 128
+	};
+	
+	SnapshotHeader();
+	
+	bool isValid(size_t fileSize) const;
+	
+	char magic[8];
+	physx::PxU32 version;
+	physx::PxU32 physxVersion;
+	physx::PxU32 numActors;
+	physx::PxU32 reserved;
+	physx::PxU64 dataSize;
+};
+
+// File mapped copy-on-write: PhysX patches pointers in place while deserializing,
+// and the objects live in the mapping until they are released.
+class MappedFile
+{
+public:
+	
+	MappedFile();
+	~MappedFile();
+	
+	bool open(const string& path);
+	void close();
+	
+	inline bool isOpen() const { return data != NULL; }
+	inline void* getData() const { return data; }
+	inline size_t size() const { return length; }
+	
+protected:
+	
+	void *data;
+	size_t length;
+	
+#ifdef TARGET_WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+	
+private:
+	
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+};
+
+OFX_PHYSX_END_NAMESPACE
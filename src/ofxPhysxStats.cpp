@@ -0,0 +1,254 @@
+#include "ofxPhysXStats.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+TimingSeries::TimingSeries(size_t window) : next(0), count(0), last(0)
+{
+	setWindow(window);
+}
+
+void TimingSeries::setWindow(size_t window)
+{
+	samples.assign(max<size_t>(window, 1), 0);
+	next = count = 0;
+	last = 0;
+}
+
+void TimingSeries::add(float ms)
+{
+	samples[next] = ms;
+	next = (next + 1) % samples.size();
+	count = min(count + 1, samples.size());
+	last = ms;
+}
+
+void TimingSeries::clear()
+{
+	next = count = 0;
+	last = 0;
+}
+
+float TimingSeries::getMin() const
+{
+	if (!count) return 0;
+	return *min_element(samples.begin(), samples.begin() + count);
+}
+
+float TimingSeries::getMax() const
+{
+	if (!count) return 0;
+	return *max_element(samples.begin(), samples.begin() + count);
+}
+
+float TimingSeries::getMean() const
+{
+	if (!count) return 0;
+	
+	double sum = 0;
+	for (size_t i = 0; i < count; i++)
+		sum += samples[i];
+	
+	return sum / count;
+}
+
+float TimingSeries::getPercentile(float p) const
+{
+	if (!count) return 0;
+	
+	// the window is filled from the front, so the first count entries are valid
+	vector<float> sorted(samples.begin(), samples.begin() + count);
+	
+	size_t k = ofClamp(p, 0, 1) * (count - 1) + 0.5;
+	nth_element(sorted.begin(), sorted.begin() + k, sorted.end());
+	
+	return sorted[k];
+}
+
+//
+
+WorldStats::WorldStats() : numSteps(0)
+{
+}
+
+const char* WorldStats::getPhaseName(Phase phase)
+{
+	static const char* names[NUM_PHASES] = {
+		"force_fields",
+		"simulate",
+		"fetch",
+		"callbacks",
+		"poses",
+		"debug_draw",
+		"shape_draw"
+	};
+	
+	return names[phase];
+}
+
+void WorldStats::setWindow(size_t window)
+{
+	for (int i = 0; i < NUM_PHASES; i++)
+		timings[i].setWindow(window);
+}
+
+void WorldStats::clear()
+{
+	for (int i = 0; i < NUM_PHASES; i++)
+		timings[i].clear();
+	
+	counts = Counts();
+	numSteps = 0;
+}
+
+void WorldStats::addSample(Phase phase, unsigned long long micros)
+{
+	timings[phase].add(micros / 1000.);
+}
+
+void WorldStats::update(const physx::PxSimulationStatistics& s)
+{
+	counts.activeDynamicBodies = s.nbActiveDynamicBodies;
+	counts.activeKinematicBodies = s.nbActiveKinematicBodies;
+	counts.dynamicBodies = s.nbDynamicBodies;
+	counts.staticBodies = s.nbStaticBodies;
+	counts.aggregates = s.nbAggregates;
+	counts.constraints = s.nbActiveConstraints;
+	
+	counts.broadPhaseAdds = s.getNbBroadPhaseAdds(physx::PxSimulationStatistics::eRIGID_BODY);
+	counts.broadPhaseRemoves = s.getNbBroadPhaseRemoves(physx::PxSimulationStatistics::eRIGID_BODY);
+	
+	counts.contactPairs = 0;
+	counts.triggerPairs = 0;
+	counts.ccdPairs = 0;
+	
+	for (int i = 0; i < physx::PxGeometryType::eGEOMETRY_COUNT; i++)
+	{
+		for (int j = i; j < physx::PxGeometryType::eGEOMETRY_COUNT; j++)
+		{
+			physx::PxGeometryType::Enum a = (physx::PxGeometryType::Enum)i;
+			physx::PxGeometryType::Enum b = (physx::PxGeometryType::Enum)j;
+			
+			counts.contactPairs += s.getRbPairStats(physx::PxSimulationStatistics::eDISCRETE_CONTACT_PAIRS, a, b);
+			counts.triggerPairs += s.getRbPairStats(physx::PxSimulationStatistics::eTRIGGER_PAIRS, a, b);
+			counts.ccdPairs += s.getRbPairStats(physx::PxSimulationStatistics::eCCD_PAIRS, a, b);
+		}
+	}
+	
+	numSteps++;
+}
+
+void WorldStats::draw(float x, float y) const
+{
+	stringstream ss;
+	ss << fixed << setprecision(3);
+	ss << "phase         last     min    mean     p99 (ms)" << endl;
+	
+	for (int i = 0; i < NUM_PHASES; i++)
+	{
+		const TimingSeries &t = timings[i];
+		ss << left << setw(12) << getPhaseName((Phase)i) << right
+			<< setw(8) << t.getLast()
+			<< setw(8) << t.getMin()
+			<< setw(8) << t.getMean()
+			<< setw(8) << t.getP99() << endl;
+	}
+	
+	ss << endl;
+	ss << "active bodies " << counts.activeDynamicBodies << " / " << counts.dynamicBodies << endl;
+	ss << "kinematic     " << counts.activeKinematicBodies << endl;
+	ss << "contact pairs " << counts.contactPairs << endl;
+	ss << "trigger pairs " << counts.triggerPairs << endl;
+	ss << "bp adds / rms " << counts.broadPhaseAdds << " / " << counts.broadPhaseRemoves << endl;
+	ss << "constraints   " << counts.constraints;
+	
+	ofDrawBitmapStringHighlight(ss.str(), x, y);
+}
+
+string WorldStats::toCSV() const
+{
+	stringstream ss;
+	ss << "metric,value" << endl;
+	
+	for (int i = 0; i < NUM_PHASES; i++)
+	{
+		const TimingSeries &t = timings[i];
+		const char *name = getPhaseName((Phase)i);
+		
+		ss << name << ".last," << t.getLast() << endl;
+		ss << name << ".min," << t.getMin() << endl;
+		ss << name << ".mean," << t.getMean() << endl;
+		ss << name << ".p99," << t.getP99() << endl;
+		ss << name << ".max," << t.getMax() << endl;
+	}
+	
+	ss << "steps," << numSteps << endl;
+	ss << "active_dynamic_bodies," << counts.activeDynamicBodies << endl;
+	ss << "active_kinematic_bodies," << counts.activeKinematicBodies << endl;
+	ss << "dynamic_bodies," << counts.dynamicBodies << endl;
+	ss << "static_bodies," << counts.staticBodies << endl;
+	ss << "aggregates," << counts.aggregates << endl;
+	ss << "broadphase_adds," << counts.broadPhaseAdds << endl;
+	ss << "broadphase_removes," << counts.broadPhaseRemoves << endl;
+	ss << "contact_pairs," << counts.contactPairs << endl;
+	ss << "trigger_pairs," << counts.triggerPairs << endl;
+	ss << "ccd_pairs," << counts.ccdPairs << endl;
+	ss << "constraints," << counts.constraints << endl;
+	
+	return ss.str();
+}
+
+string WorldStats::toJSON() const
+{
+	stringstream ss;
+	ss << "{" << endl;
+	ss << "\t\"timings\": {" << endl;
+	
+	for (int i = 0; i < NUM_PHASES; i++)
+	{
+		const TimingSeries &t = timings[i];
+		
+		ss << "\t\t\"" << getPhaseName((Phase)i) << "\": { "
+			<< "\"last\": " << t.getLast() << ", "
+			<< "\"min\": " << t.getMin() << ", "
+			<< "\"mean\": " << t.getMean() << ", "
+			<< "\"p99\": " << t.getP99() << ", "
+			<< "\"max\": " << t.getMax() << " }"
+			<< (i < NUM_PHASES - 1 ? "," : "") << endl;
+	}
+	
+	ss << "\t}," << endl;
+	ss << "\t\"steps\": " << numSteps << "," << endl;
+	ss << "\t\"counts\": {" << endl;
+	ss << "\t\t\"active_dynamic_bodies\": " << counts.activeDynamicBodies << "," << endl;
+	ss << "\t\t\"active_kinematic_bodies\": " << counts.activeKinematicBodies << "," << endl;
+	ss << "\t\t\"dynamic_bodies\": " << counts.dynamicBodies << "," << endl;
+	ss << "\t\t\"static_bodies\": " << counts.staticBodies << "," << endl;
+	ss << "\t\t\"aggregates\": " << counts.aggregates << "," << endl;
+	ss << "\t\t\"broadphase_adds\": " << counts.broadPhaseAdds << "," << endl;
+	ss << "\t\t\"broadphase_removes\": " << counts.broadPhaseRemoves << "," << endl;
+	ss << "\t\t\"contact_pairs\": " << counts.contactPairs << "," << endl;
+	ss << "\t\t\"trigger_pairs\": " << counts.triggerPairs << "," << endl;
+	ss << "\t\t\"ccd_pairs\": " << counts.ccdPairs << "," << endl;
+	ss << "\t\t\"constraints\": " << counts.constraints << endl;
+	ss << "\t}" << endl;
+	ss << "}" << endl;
+	
+	return ss.str();
+}
+
+bool WorldStats::save(const string& path) const
+{
+	const bool json = ofToLower(ofFilePath::getFileExt(path)) == "json";
+	
+	ofFile file(path, ofFile::WriteOnly);
+	if (!file.is_open())
+	{
+		ofLogError("ofxPhysX::WorldStats") << "can't open " << path;
+		return false;
+	}
+	
+	file << (json ? toJSON() : toCSV());
+	return true;
+}
+
+OFX_PHYSX_END_NAMESPACE
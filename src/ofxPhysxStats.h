@@ -0,0 +1,130 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Rolling window of timings in milliseconds
+class TimingSeries
+{
+public:
+	
+	TimingSeries(size_t window = 240);
+	
+	void setWindow(size_t window);
+	inline size_t getWindow() const { return samples.size(); }
+	
+	void add(float ms);
+	void clear();
+	
+	inline size_t size() const { return count; }
+	inline bool empty() const { return count == 0; }
+	
+	inline float getLast() const { return last; }
+	float getMin() const;
+	float getMax() const;
+	float getMean() const;
+	
+	// p in [0, 1]
+	float getPercentile(float p) const;
+	inline float getP99() const { return getPercentile(0.99); }
+	
+protected:
+	
+	vector<float> samples;
+	size_t next;
+	size_t count;
+	float last;
+};
+
+// Per phase timings and simulation counts collected by World, see World::getStats()
+class WorldStats
+{
+public:
+	
+	enum Phase
+	{
+		FORCE_FIELDS,	// force field evaluation before each step
+		SIMULATE,		// PxScene::simulate() call, per step
+		FETCH,			// blocked in fetchResults() incl. callbacks, per step
+		CALLBACKS,		// simulation event callbacks, per step
+		POSES,			// pose cache and debug geometry update after each step
+		DEBUG_DRAW,		// World::draw()
+		SHAPE_DRAW,		// World::drawShapes()
+		NUM_PHASES
+	};
+	
+	// from PxSimulationStatistics after the last step
+	struct Counts
+	{
+		Counts() { memset(this, 0, sizeof(Counts)); }
+		
+		physx::PxU32 activeDynamicBodies;
+		physx::PxU32 activeKinematicBodies;
+		physx::PxU32 dynamicBodies;
+		physx::PxU32 staticBodies;
+		physx::PxU32 aggregates;
+		physx::PxU32 broadPhaseAdds;
+		physx::PxU32 broadPhaseRemoves;
+		physx::PxU32 contactPairs;		// broadphase pairs that went through narrowphase
+		physx::PxU32 triggerPairs;
+		physx::PxU32 ccdPairs;
+		physx::PxU32 constraints;
+	};
+	
+	WorldStats();
+	
+	static const char* getPhaseName(Phase phase);
+	
+	inline TimingSeries& get(Phase phase) { return timings[phase]; }
+	inline const TimingSeries& get(Phase phase) const { return timings[phase]; }
+	
+	inline const Counts& getCounts() const { return counts; }
+	inline physx::PxU32 getNumSteps() const { return numSteps; }
+	
+	void setWindow(size_t window);
+	void clear();
+	
+	// called by World
+	void addSample(Phase phase, unsigned long long micros);
+	void update(const physx::PxSimulationStatistics& s);
+	
+	// on-screen table of last / min / mean / p99 per phase and the counts
+	void draw(float x = 10, float y = 20) const;
+	
+	string toCSV() const;
+	string toJSON() const;
+	
+	// format picked by the extension, .json or anything else for csv
+	bool save(const string& path) const;
+	
+protected:
+	
+	TimingSeries timings[NUM_PHASES];
+	Counts counts;
+	physx::PxU32 numSteps;
+};
+
+// Adds the time between construction and destruction to a phase
+class ScopedPhaseTimer
+{
+public:
+	
+	ScopedPhaseTimer(WorldStats *stats, WorldStats::Phase phase) : stats(stats), phase(phase)
+	{
+		if (stats) start = ofGetElapsedTimeMicros();
+	}
+	
+	~ScopedPhaseTimer()
+	{
+		if (stats) stats->addSample(phase, ofGetElapsedTimeMicros() - start);
+	}
+	
+protected:
+	
+	WorldStats *stats;
+	WorldStats::Phase phase;
+	unsigned long long start;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,184 @@
+#include "ofxPhysXTaskScheduler.h"
+
+#include "Poco/Environment.h"
+
+#if defined(TARGET_LINUX)
+#include <pthread.h>
+#include <sched.h>
+#elif defined(TARGET_OSX)
+#include <mach/mach.h>
+#include <mach/thread_policy.h>
+#endif
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+static void pinCurrentThread(int core)
+{
+#if defined(TARGET_LINUX)
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(core % TaskScheduler::getNumCores(), &set);
+	pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#elif defined(TARGET_OSX)
+	thread_affinity_policy_data_t policy = { core + 1 };
+	thread_policy_set(mach_thread_self(), THREAD_AFFINITY_POLICY, (thread_policy_t)&policy, THREAD_AFFINITY_POLICY_COUNT);
+#else
+	ofLogWarning("ofxPhysX::TaskScheduler") << "thread pinning is not supported on this platform";
+#endif
+}
+
+int TaskSchedulerSettings::getNumThreads() const
+{
+	if (numThreads >= 0)
+		return numThreads;
+	
+	return max(TaskScheduler::getNumCores() - 1, 1);
+}
+
+//
+
+TaskScheduler::TaskScheduler(const TaskSchedulerSettings& settings) :
+	settings(settings),
+	available(0, 0x7fffffff),
+	quit(0),
+	roundRobin(0)
+{
+	const int n = settings.getNumThreads();
+	
+	for (int i = 0; i < n; i++)
+		workers.push_back(new Worker(this, i));
+	
+	for (int i = 0; i < n; i++)
+	{
+		Worker *w = workers[i];
+		w->thread.setName("ofxPhysX::TaskScheduler " + ofToString(i));
+		w->thread.setPriority(settings.priority);
+		w->thread.start(*w);
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	quit = 1;
+	
+	for (size_t i = 0; i < workers.size(); i++)
+		available.set();
+	
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i]->thread.join();
+		delete workers[i];
+	}
+	
+	workers.clear();
+}
+
+void TaskScheduler::submitTask(physx::PxBaseTask& task)
+{
+	if (workers.empty())
+	{
+		task.run();
+		task.release();
+		return;
+	}
+	
+	// tasks spawned by a worker stay on its deque, the rest are spread out
+	Worker *w = getCurrentWorker();
+	if (!w)
+		w = workers[(unsigned int)roundRobin++ % workers.size()];
+	
+	w->push(&task);
+	available.set();
+}
+
+physx::PxU32 TaskScheduler::getWorkerCount() const
+{
+	return workers.size();
+}
+
+int TaskScheduler::getNumCores()
+{
+	return max((int)Poco::Environment::processorCount(), 1);
+}
+
+physx::PxBaseTask* TaskScheduler::next(int index)
+{
+	physx::PxBaseTask *task = workers[index]->pop();
+	if (task) return task;
+	
+	const int n = workers.size();
+	for (int i = 1; i < n; i++)
+	{
+		task = workers[(index + i) % n]->steal();
+		if (task) return task;
+	}
+	
+	return NULL;
+}
+
+TaskScheduler::Worker* TaskScheduler::getCurrentWorker() const
+{
+	Poco::Thread *current = Poco::Thread::current();
+	if (!current) return NULL;
+	
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		if (&workers[i]->thread == current)
+			return workers[i];
+	}
+	
+	return NULL;
+}
+
+//
+
+void TaskScheduler::Worker::run()
+{
+	if (scheduler->settings.pinThreads)
+		pinCurrentThread(scheduler->settings.firstCore + index);
+	
+	while (true)
+	{
+		scheduler->available.wait();
+		
+		if (scheduler->quit.value())
+			break;
+		
+		// every count matches a queued task, so this only spins while a
+		// thief and the owner race for the same deque
+		physx::PxBaseTask *task = NULL;
+		while (!task)
+			task = scheduler->next(index);
+		
+		task->run();
+		task->release();
+	}
+}
+
+void TaskScheduler::Worker::push(physx::PxBaseTask *task)
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	tasks.push_back(task);
+}
+
+physx::PxBaseTask* TaskScheduler::Worker::pop()
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	if (tasks.empty()) return NULL;
+	
+	physx::PxBaseTask *task = tasks.back();
+	tasks.pop_back();
+	return task;
+}
+
+physx::PxBaseTask* TaskScheduler::Worker::steal()
+{
+	Poco::FastMutex::ScopedLock lock(mutex);
+	if (tasks.empty()) return NULL;
+	
+	physx::PxBaseTask *task = tasks.front();
+	tasks.pop_front();
+	return task;
+}
+
+OFX_PHYSX_END_NAMESPACE
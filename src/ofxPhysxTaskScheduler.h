@@ -0,0 +1,91 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+
+#include "Poco/Thread.h"
+#include "Poco/Runnable.h"
+#include "Poco/Mutex.h"
+#include "Poco/Semaphore.h"
+#include "Poco/AtomicCounter.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+struct TaskSchedulerSettings
+{
+	enum { AUTO = -1 };
+	
+	TaskSchedulerSettings() :
+		numThreads(AUTO),
+		priority(Poco::Thread::PRIO_NORMAL),
+		pinThreads(false),
+		firstCore(0),
+		workStealing(true)
+	{}
+	
+	// AUTO leaves one core for the calling thread
+	int numThreads;
+	
+	Poco::Thread::Priority priority;
+	
+	// pin worker i to core firstCore + i (a hint on OS X)
+	bool pinThreads;
+	int firstCore;
+	
+	// false falls back to PxDefaultCpuDispatcher with numThreads workers
+	bool workStealing;
+	
+	int getNumThreads() const;
+};
+
+// A PxCpuDispatcher with one task deque per worker. Workers pop their own deque
+// LIFO and steal FIFO from the others when it runs dry. The app can submit its
+// own PxBaseTasks or use parallelFor() on it, and share one instance between
+// Worlds, so physics and app jobs don't oversubscribe the cores.
+class TaskScheduler : public physx::PxCpuDispatcher
+{
+public:
+	
+	TaskScheduler(const TaskSchedulerSettings& settings = TaskSchedulerSettings());
+	virtual ~TaskScheduler();
+	
+	void submitTask(physx::PxBaseTask& task);
+	physx::PxU32 getWorkerCount() const;
+	
+	static int getNumCores();
+	
+protected:
+	
+	class Worker : public Poco::Runnable
+	{
+	public:
+		
+		Worker(TaskScheduler *scheduler, int index) : scheduler(scheduler), index(index) {}
+		
+		void run();
+		
+		void push(physx::PxBaseTask *task);
+		physx::PxBaseTask* pop();
+		physx::PxBaseTask* steal();
+		
+		TaskScheduler *scheduler;
+		int index;
+		
+		Poco::Thread thread;
+		Poco::FastMutex mutex;
+		deque<physx::PxBaseTask*> tasks;
+	};
+	
+	physx::PxBaseTask* next(int index);
+	Worker* getCurrentWorker() const;
+	
+	TaskSchedulerSettings settings;
+	vector<Worker*> workers;
+	
+	// one count per queued task
+	Poco::Semaphore available;
+	
+	Poco::AtomicCounter quit;
+	Poco::AtomicCounter roundRobin;
+};
+
+OFX_PHYSX_END_NAMESPACE
@@ -1,31 +1,220 @@
 #include "ofxPhysXWorld.h"
+#include "ofxPhysXCompoundBuilder.h"
+#include "Poco/AtomicCounter.h"
 
 OFX_PHYSX_BEGIN_NAMESPACE
 
 #define ASSERT(S) if (!S) { assert(S); return false; }
 
-static physx::PxDefaultErrorCallback gDefaultErrorCallback;
-static physx::PxDefaultAllocator gDefaultAllocatorCallback;
-static physx::PxSimulationFilterShader gDefaultFilterShader = physx::PxDefaultSimulationFilterShader;
+const physx::PxU32 World::MAX_AGGREGATE_SIZE;
+const physx::PxU32 World::DEFAULT_GROUP;
+const physx::PxU32 World::ALL_GROUPS;
+const physx::PxI16 World::MAX_HEIGHT_SAMPLE;
+
+static physx::PxQueryFilterData toFilterData(physx::PxU32 mask, physx::PxQueryFlags flags = physx::PxQueryFlag::eSTATIC | physx::PxQueryFlag::eDYNAMIC)
+{
+	return physx::PxQueryFilterData(physx::PxFilterData(mask, 0, 0, 0), flags);
+}
+
+static void toQueryHit(const physx::PxLocationHit& src, QueryHit& dst)
+{
+	dst.actor = src.actor;
+	dst.shape = src.shape;
+	toOF(src.position, dst.position);
+	toOF(src.normal, dst.normal);
+	dst.distance = src.distance;
+	dst.hit = true;
+}
+
+// per-body parameters are either shared by all bodies or given for each one
+static bool checkSize(const char *name, size_t size, size_t count, bool optional = false)
+{
+	if (size == 1 || size == count || (optional && size == 0))
+		return true;
+	
+	ofLogError("ofxPhysX::World") << name << " has " << size << " entries for " << count << " bodies";
+	return false;
+}
+
+// a shape on another actor with the same geometry, material, flags and filters
+static physx::PxShape* copyShape(physx::PxShape *shape, physx::PxRigidActor *actor)
+{
+	physx::PxMaterial *material;
+	shape->getMaterials(&material, 1);
+	
+	physx::PxShape *copy = actor->createShape(shape->getGeometry().any(), *material, shape->getLocalPose());
+	copy->setFlags(shape->getFlags());
+	copy->setSimulationFilterData(shape->getSimulationFilterData());
+	copy->setQueryFilterData(shape->getQueryFilterData());
+	return copy;
+}
+
+// Scale the mass of a single shape body with its volume and recompute the
+// inertia of the new geometry in closed form, keeping the body's density.
+static void updateMass(physx::PxRigidBody *body, const physx::PxGeometry& before, const physx::PxShape *shape)
+{
+	const physx::PxMassProperties unit(before);
+	if (unit.mass <= 0) return;
+	
+	physx::PxMassProperties props = physx::PxMassProperties(shape->getGeometry().any()) * (body->getMass() / unit.mass);
+	if (props.mass <= 0) return;
+	
+	const physx::PxTransform local = shape->getLocalPose();
+	props.rotateInertia(local.q);
+	props.translate(local.p);
+	
+	physx::PxQuat orient;
+	physx::PxVec3 inertia = physx::PxMassProperties::getMassSpaceInertia(props.inertiaTensor, orient);
+	
+	body->setMass(props.mass);
+	body->setCMassLocalPose(physx::PxTransform(props.centerOfMass, orient));
+	body->setMassSpaceInertiaTensor(inertia);
+}
+
+static inline physx::PxI16 toHeightSample(float v)
+{
+	return ofClamp(v, -1, 1) * World::MAX_HEIGHT_SAMPLE;
+}
+
+static inline physx::PxI16 toHeightSample(unsigned short v)
+{
+	return v >> 1;
+}
+
+// PhysX rows run along x, so pixel (x, y) goes to row x, column y
+template <typename T>
+static void toHeightSamples(const ofPixels_<T>& pixels, vector<physx::PxHeightFieldSample>& samples)
+{
+	const int w = pixels.getWidth();
+	const int h = pixels.getHeight();
+	const int channels = pixels.getNumChannels();
+	const T *data = pixels.getPixels();
+	
+	samples.resize(w * h);
+	
+	for (int y = 0; y < h; y++)
+	{
+		for (int x = 0; x < w; x++)
+		{
+			physx::PxHeightFieldSample& s = samples[x * h + y];
+			s.height = toHeightSample(data[(y * w + x) * channels]);
+			s.materialIndex0 = 0;
+			s.materialIndex1 = 0;
+		}
+	}
+}
+
+// simulation filter data: word0 group bits, word1 collision mask,
+// word2 Event::Report flags, word3 contact force threshold
+static physx::PxFilterFlags gGroupFilterShader(physx::PxFilterObjectAttributes attributes0, physx::PxFilterData filterData0, physx::PxFilterObjectAttributes attributes1, physx::PxFilterData filterData1, physx::PxPairFlags& pairFlags, const void* constantBlock, physx::PxU32 constantBlockSize)
+{
+	// shapes without a group were not created by World and collide with everything
+	if (filterData0.word0 && filterData1.word0)
+	{
+		if ((filterData0.word0 & filterData1.word1) == 0 || (filterData1.word0 & filterData0.word1) == 0)
+		{
+			const physx::PxU32 suppressed = constantBlockSize ? *(const physx::PxU32*)constantBlock : 0;
+			if ((filterData0.word0 | filterData1.word0) & suppressed)
+				return physx::PxFilterFlag::eSUPPRESS;
+			
+			return physx::PxFilterFlag::eKILL;
+		}
+	}
+	
+	if (physx::PxFilterObjectIsTrigger(attributes0) || physx::PxFilterObjectIsTrigger(attributes1))
+	{
+		pairFlags = physx::PxPairFlag::eTRIGGER_DEFAULT;
+		return physx::PxFilterFlag::eDEFAULT;
+	}
+	
+	pairFlags = physx::PxPairFlag::eCONTACT_DEFAULT;
+	
+	const physx::PxU32 report = filterData0.word2 | filterData1.word2;
+	
+	// with a threshold PhysX drops the weak pairs before any points are extracted
+	if (filterData0.word3 || filterData1.word3)
+	{
+		if (report & Event::REPORT_CONTACT_BEGIN)
+			pairFlags |= physx::PxPairFlag::eNOTIFY_THRESHOLD_FORCE_FOUND | physx::PxPairFlag::eNOTIFY_CONTACT_POINTS;
+		if (report & Event::REPORT_CONTACT_PERSIST)
+			pairFlags |= physx::PxPairFlag::eNOTIFY_THRESHOLD_FORCE_PERSISTS | physx::PxPairFlag::eNOTIFY_CONTACT_POINTS;
+		if (report & Event::REPORT_CONTACT_END)
+			pairFlags |= physx::PxPairFlag::eNOTIFY_THRESHOLD_FORCE_LOST;
+		
+		return physx::PxFilterFlag::eDEFAULT;
+	}
+	
+	if (report & Event::REPORT_CONTACT_BEGIN)
+		pairFlags |= physx::PxPairFlag::eNOTIFY_TOUCH_FOUND | physx::PxPairFlag::eNOTIFY_CONTACT_POINTS;
+	if (report & Event::REPORT_CONTACT_PERSIST)
+		pairFlags |= physx::PxPairFlag::eNOTIFY_TOUCH_PERSISTS | physx::PxPairFlag::eNOTIFY_CONTACT_POINTS;
+	if (report & Event::REPORT_CONTACT_END)
+		pairFlags |= physx::PxPairFlag::eNOTIFY_TOUCH_LOST;
+	
+	return physx::PxFilterFlag::eDEFAULT;
+}
+
+static physx::PxSimulationFilterShader gDefaultFilterShader = gGroupFilterShader;
+
+Allocator& World::getAllocator()
+{
+	// never destroyed, PhysX objects may be released from static destructors
+	static Allocator *allocator = new Allocator;
+	return *allocator;
+}
 
 World::World() :
+	sdk(NULL),
 	foundation(NULL),
-	profileZoneManager(NULL),
 	physics(NULL),
 	cpuDispatcher(NULL),
+	defaultDispatcher(NULL),
+	taskScheduler(NULL),
+	ownsTaskScheduler(false),
 	scene(NULL),
 	defaultMaterial(NULL),
-	cudaContextManager(NULL)
+	fixedTimestep(0),
+	maxSubSteps(4),
+	accumulator(0),
+	interpolationAlpha(1),
+	pipelined(false),
+	simulating(false),
+	debugDraw(true),
+	statsEnabled(true),
+	allocationTracking(true),
+	scratchBlock(NULL),
+	scratchSize(256 * 1024),
+	actorPoolSize(1024)
 {
+	filterSettings.suppressedGroups = 0;
+	poses.setOwner(this);
 }
 
 World::~World()
 {
-	clear();
+	// no GL here, the context may be gone already
+	releaseScene();
 }
 
 void World::clear()
 {
+	releaseScene();
+	
+	// groups are keyed on mesh addresses, which the released meshes free up
+	shapeRenderer.clear();
+}
+
+void World::exit()
+{
+	clear();
+	debugRenderer.release();
+	shapeRenderer.release();
+}
+
+void World::releaseScene()
+{
+	waitForSimulation();
+	
 	if (defaultMaterial)
 		defaultMaterial->release();
 	defaultMaterial = NULL;
@@ -43,61 +232,115 @@ void World::clear()
 		vector<physx::PxActor*> buffer(n);
 		scene->getActors(t, buffer.data(), n);
 		
+		if (n > 0)
+			scene->removeActors(buffer.data(), n);
+		
 		for (int i = 0; i < buffer.size(); i++)
-		{
-			scene->removeActor(*buffer[i]);
 			buffer[i]->release();
+		
+		for (int i = 0; i < batchQueries.size(); i++)
+		{
+			if (batchQueries[i].query)
+				batchQueries[i].query->release();
 		}
-
+		
+		for (int i = 0; i < aggregates.size(); i++)
+		{
+			scene->removeAggregate(*aggregates[i]);
+			aggregates[i]->release();
+		}
+		
 		scene->release();
 	}
 	scene = NULL;
+	aggregates.clear();
+	batchQueries.clear();
+	
+	{
+		Poco::FastMutex::ScopedLock lock(targetMutex);
+		stagedTargets.clear();
+	}
+	appliedTargets.clear();
+	
+	for (size_t i = 0; i < actorPool.size(); i++)
+		actorPool[i]->release();
+	actorPool.clear();
+	
+	map<ShapeKey, physx::PxShape*>::iterator it = sharedShapes.begin();
+	while (it != sharedShapes.end())
+	{
+		it->second->release();
+		it++;
+	}
+	sharedShapes.clear();
+	
+	if (defaultDispatcher)
+		defaultDispatcher->release();
+	defaultDispatcher = NULL;
+	
+	if (taskScheduler && ownsTaskScheduler)
+		delete taskScheduler;
+	taskScheduler = NULL;
+	ownsTaskScheduler = false;
 	
-	if (cpuDispatcher)
-		cpuDispatcher->release();
 	cpuDispatcher = NULL;
 	
-	if (cudaContextManager)
-		cudaContextManager->release();
-	cudaContextManager = NULL;
+	// compound prototypes hold shapes of this SDK
+	set<CompoundBuilder*> builders = compounds;
+	for (set<CompoundBuilder*>::iterator it = builders.begin(); it != builders.end(); it++)
+		(*it)->releaseShapes();
+	compounds.clear();
 	
-	if (physics)
-		physics->release();
+	meshCooker.clear();
+	
+	// other Worlds may still hold the SDK, which outlives the loaded objects
+	if (sdk)
+	{
+		for (int i = 0; i < snapshots.size(); i++)
+			sdk->keepMapping(snapshots[i]);
+		sdk->release();
+	}
+	sdk = NULL;
+	snapshots.clear();
+	
+	foundation = NULL;
 	physics = NULL;
+	
+	if (scratchBlock)
+		getAllocator().deallocate(scratchBlock);
+	scratchBlock = NULL;
+	
+	poses.clear();
+	debugRenderer.clear();
+	
+	accumulator = 0;
+	interpolationAlpha = 1;
+}
+
+bool World::setup(const ofVec3f& gravity, const TaskSchedulerSettings& settings)
+{
+	return setup(gravity, settings, NULL);
+}
+
+bool World::setup(const ofVec3f& gravity, TaskScheduler *scheduler)
+{
+	return setup(gravity, TaskSchedulerSettings(), scheduler);
 }
 
-bool World::setup(const ofVec3f& gravity)
+bool World::setup(const ofVec3f& gravity, const TaskSchedulerSettings& settings, TaskScheduler *scheduler)
 {
 	clear();
 	
-	foundation = PxCreateFoundation(PX_PHYSICS_VERSION, gDefaultAllocatorCallback, gDefaultErrorCallback);
-	ASSERT(foundation);
-	
-	profileZoneManager = &physx::PxProfileZoneManager::createProfileZoneManager(foundation);
-	ASSERT(profileZoneManager);
-	
-	if (1)
-	{
-		physx::PxCudaContextManagerDesc cudaContextManagerDesc;
-		cudaContextManager = physx::PxCreateCudaContextManager(*foundation, cudaContextManagerDesc, profileZoneManager);
-		
-		if (cudaContextManager && !cudaContextManager->contextIsValid())
-		{
-			cudaContextManager->release();
-			cudaContextManager = NULL;
-		}
-	}
+	getAllocator().setTagTracking(allocationTracking);
 	
-	physx::PxTolerancesScale scale;
-	scale.length = WorldScale::getWorldScale();
-	scale.mass = 1000;
-	scale.speed = scale.length * 10;
+	sdk = Sdk::acquire(getAllocator(), allocationTracking);
+	ASSERT(sdk);
 	
-	bool trackOutstandingAllocations = true;
-	physics = PxCreatePhysics(PX_PHYSICS_VERSION, *foundation, scale, trackOutstandingAllocations, profileZoneManager);
-	ASSERT(physics);
+	foundation = &sdk->getFoundation();
+	physics = &sdk->getPhysics();
 	
-	ASSERT(PxInitExtensions(*physics));
+	if (!meshCooker.setup(*foundation, *physics))
+		ofLogWarning("ofxPhysX::World") << "mesh cooking is not available";
 	
 	// default material
 	defaultMaterial = physics->createMaterial(0.5, 0.5, 0.5);
@@ -109,26 +352,58 @@ bool World::setup(const ofVec3f& gravity)
 	
 	if (!sceneDesc.cpuDispatcher)
 	{
-		cpuDispatcher = physx::PxDefaultCpuDispatcherCreate(4);
-		ASSERT(cpuDispatcher);
+		if (scheduler)
+		{
+			taskScheduler = scheduler;
+			cpuDispatcher = taskScheduler;
+		}
+		else if (settings.workStealing)
+		{
+			taskScheduler = new TaskScheduler(settings);
+			ownsTaskScheduler = true;
+			cpuDispatcher = taskScheduler;
+		}
+		else
+		{
+			vector<physx::PxU32> affinityMasks;
+			if (settings.pinThreads)
+			{
+				for (int i = 0; i < settings.getNumThreads(); i++)
+					affinityMasks.push_back(1 << ((settings.firstCore + i) % 32));
+			}
+			
+			defaultDispatcher = physx::PxDefaultCpuDispatcherCreate(settings.getNumThreads(), affinityMasks.empty() ? NULL : affinityMasks.data());
+			ASSERT(defaultDispatcher);
+			cpuDispatcher = defaultDispatcher;
+		}
+		
 		sceneDesc.cpuDispatcher	= cpuDispatcher;
 	}
 	
 	if (!sceneDesc.filterShader)
+	{
 		sceneDesc.filterShader	= gDefaultFilterShader;
+		sceneDesc.filterShaderData = &filterSettings;
+		sceneDesc.filterShaderDataSize = sizeof(filterSettings);
+	}
 	
-	if (!sceneDesc.gpuDispatcher && cudaContextManager)
-		sceneDesc.gpuDispatcher = cudaContextManager->getGpuDispatcher();
+	eventCallback.queue = &events;
+	sceneDesc.simulationEventCallback = &eventCallback;
+	
+	if (!sceneDesc.gpuDispatcher && sdk->getCudaContextManager())
+		sceneDesc.gpuDispatcher = sdk->getCudaContextManager()->getGpuDispatcher();
 
 	sceneDesc.flags |= physx::PxSceneFlag::eENABLE_ACTIVETRANSFORMS;
 	
 	scene = physics->createScene(sceneDesc);
 	ASSERT(scene);
 	
+	scene->userData = this;
+	
 	{
 		physx::PxSceneWriteLock scopedLock(*scene);
 		
-		scene->setVisualizationParameter(physx::PxVisualizationParameter::eSCALE, WorldScale::getWorldScale() * 0.1f);
+		scene->setVisualizationParameter(physx::PxVisualizationParameter::eSCALE, debugDraw ? WorldScale::getWorldScale() * 0.1f : 0.0f);
 		scene->setVisualizationParameter(physx::PxVisualizationParameter::eCOLLISION_SHAPES, 1.0f);
 		
 		scene->setVisualizationParameter(physx::PxVisualizationParameter::eCONTACT_NORMAL, 1.0f);
@@ -150,14 +425,60 @@ void World::update()
 		return;
 	}
 	
+	// collect the step started at the end of the last update
+	endStep();
+	
+	float dt;
+	int n = advance(getFrameTime(), dt);
+	
+	for (int i = 0; i < n; i++)
+	{
+		beginStep(dt);
+		
+		// in pipelined mode the last step runs while the app draws
+		if (!pipelined || i < n - 1)
+			endStep(n - 1 - i);
+	}
+}
+
+float World::getFrameTime()
+{
 	float t = ofGetLastFrameTime();
-	if (t <= 0) t = 1. / 60.;
+	return t > 0 ? t : 1. / 60.;
+}
+
+int World::advance(float t, float& dt)
+{
+	int n = 1;
+	dt = t;
+	
+	if (fixedTimestep > 0)
+	{
+		dt = fixedTimestep;
+		accumulator += t;
+		
+		n = 0;
+		while (accumulator >= fixedTimestep && n < maxSubSteps)
+		{
+			accumulator -= fixedTimestep;
+			n++;
+		}
+		
+		// drop the time we could not catch up with instead of spiralling
+		if (accumulator >= fixedTimestep)
+			accumulator = fmodf(accumulator, fixedTimestep);
+		
+		interpolationAlpha = accumulator / fixedTimestep;
+	}
+	else
+	{
+		interpolationAlpha = 1;
+	}
 	
-	scene->simulate(t);
-	scene->fetchResults(true);
+	return n;
 }
 
-void World::draw()
+void World::step(float dt)
 {
 	if (!physics)
 	{
@@ -165,137 +486,1653 @@ void World::draw()
 		return;
 	}
 	
-	glPushAttrib(GL_ALL_ATTRIB_BITS);
-	glPushMatrix();
+	endStep();
+	
+	interpolationAlpha = 1;
 	
-	const physx::PxRenderBuffer& debugRenderable = scene->getRenderBuffer();
-	const physx::PxU32 numPoints = debugRenderable.getNbPoints();
+	beginStep(dt);
+	endStep();
+}
+
+void World::beginStep(float dt)
+{
+	assert(!simulating);
+	
+	flushPendingActors();
+	applyKinematicTargets();
 	
-	const physx::PxU32 numLines = debugRenderable.getNbLines();
-	if (numLines)
+	if (!forceFields.empty())
 	{
-		const physx::PxDebugLine* PX_RESTRICT lines = debugRenderable.getLines();
-		
-		glBegin(GL_LINES);
-		for(physx::PxU32 i=0; i<numLines; i++)
-		{
-			const physx::PxDebugLine& line = lines[i];
-			ofSetHexColor(line.color0);
-			glVertex3fv(&line.pos0[0]);
-			glVertex3fv(&line.pos1[0]);
-		}
-		glEnd();
+		ScopedPhaseTimer timer(profiling(), WorldStats::FORCE_FIELDS);
+		forceFields.apply(poses, cpuDispatcher);
 	}
 	
-	const physx::PxU32 numTriangles = debugRenderable.getNbTriangles();
-	if(numTriangles)
+	if (scratchSize && !scratchBlock)
+		scratchBlock = getAllocator().allocate(scratchSize, "ofxPhysX::World::scratch", __FILE__, __LINE__);
+	
 	{
-		const physx::PxDebugTriangle* PX_RESTRICT triangles = debugRenderable.getTriangles();
-		
-		glBegin(GL_TRIANGLES);
-		for(physx::PxU32 i=0; i < numTriangles; i++)
-		{
-			const physx::PxDebugTriangle& triangle = triangles[i];
-			ofSetHexColor(triangle.color0);
-			glVertex3fv(&triangle.pos0[0]);
-			glVertex3fv(&triangle.pos1[0]);
-			glVertex3fv(&triangle.pos2[0]);
-		}
-		glEnd();
+		ScopedPhaseTimer timer(profiling(), WorldStats::SIMULATE);
+		scene->simulate(dt, NULL, scratchBlock, scratchBlock ? scratchSize : 0);
 	}
 	
-	glPopMatrix();
-	glPopAttrib();
+	simulating = true;
 }
 
-//
-
-physx::PxRigidActor* World::createRigid(const ofVec3f& pos, const ofQuaternion& rot, float density)
+void World::endStep(int remaining)
 {
-	physx::PxTransform transform;
-	toPx(pos, transform.p);
-	toPx(rot, transform.q);
+	if (!simulating) return;
 	
-	physx::PxRigidActor *actor;
+	eventCallback.timing = statsEnabled;
+	eventCallback.elapsedMicros = 0;
 	
-	if (density > 0)
 	{
-		physx::PxRigidDynamic* rigid = physics->createRigidDynamic(transform);
-		rigid->setLinearDamping(0.25);
-		rigid->setAngularDamping(0.25);
-		actor = rigid;
+		ScopedPhaseTimer timer(profiling(), WorldStats::FETCH);
+		scene->fetchResults(true);
 	}
-	else
+	
+	simulating = false;
+	
+	if (statsEnabled)
 	{
-		physx::PxRigidStatic *rigid = physics->createRigidStatic(transform);
-		actor = rigid;
+		stats.addSample(WorldStats::CALLBACKS, eventCallback.elapsedMicros);
+		
+		physx::PxSimulationStatistics s;
+		scene->getSimulationStatistics(s);
+		stats.update(s);
 	}
 	
-	assert(actor);
-	scene->addActor(*actor);
+	ScopedPhaseTimer timer(profiling(), WorldStats::POSES);
 	
-	return actor;
+	physx::PxU32 numActive = 0;
+	const physx::PxActiveTransform *active = scene->getActiveTransforms(numActive);
+	
+	// force fields read the poses before every substep
+	if (remaining <= 1 || !forceFields.empty())
+		poses.update(active, numActive);
+	else
+		poses.skip(active, numActive);
+	
+	// keep a copy so draw() stays valid while the next step is in flight
+	if (debugDraw && remaining == 0)
+		debugRenderer.update(scene->getRenderBuffer());
+	
+	// after the active transforms, which may still point at removed actors
+	flushPendingActors();
 }
 
-physx::PxRigidActor* World::updateMassAndInertia(physx::PxRigidActor *rigid, float density)
+void World::waitForSimulation()
 {
-	if (density <= 0) return rigid;
+	endStep();
+	flushPendingActors();
+}
+
+void World::flushPendingActors()
+{
+	if (simulating || !scene) return;
 	
-	physx::PxRigidBody *rigidbody = rigid->isRigidBody();
-	if (rigidbody)
-		physx::PxRigidBodyExt::updateMassAndInertia(*rigidbody, density);
+	if (!pendingAdds.empty())
+	{
+		scene->addActors(pendingAdds.data(), pendingAdds.size());
+		pendingAdds.clear();
+	}
 	
-	return rigid;
+	for (size_t i = 0; i < pendingAggregates.size(); i++)
+	{
+		scene->addAggregate(*pendingAggregates[i]);
+		aggregates.push_back(pendingAggregates[i]);
+	}
+	pendingAggregates.clear();
+	
+	if (pendingRemovals.empty()) return;
+	
+	// an actor removed twice before the flush is released once
+	sort(pendingRemovals.begin(), pendingRemovals.end());
+	pendingRemovals.erase(unique(pendingRemovals.begin(), pendingRemovals.end()), pendingRemovals.end());
+	
+	scene->removeActors(pendingRemovals.data(), pendingRemovals.size());
+	
+	for (size_t i = 0; i < pendingRemovals.size(); i++)
+		recycleActor(pendingRemovals[i]);
+	
+	pendingRemovals.clear();
 }
 
-//
+void World::dropActor(physx::PxActor *actor)
+{
+	// an actor still queued for the scene never joined it
+	if (!actor->getScene() && !actor->getAggregate())
+	{
+		vector<physx::PxActor*>::iterator it = find(pendingAdds.begin(), pendingAdds.end(), actor);
+		if (it != pendingAdds.end())
+		{
+			pendingAdds.erase(it);
+			recycleActor(actor);
+			return;
+		}
+	}
+	
+	pendingRemovals.push_back(actor);
+}
 
-physx::PxActor* World::addBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot, float density)
+void World::recycleActor(physx::PxActor *actor)
 {
-	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
-	rigid->createShape(physx::PxBoxGeometry(toPx(size / 2)), *defaultMaterial);
-	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+	physx::PxRigidDynamic *body = actor->isRigidDynamic();
+	
+	if (body && !body->getAggregate() && actorPool.size() < actorPoolSize)
+	{
+		// exclusive shapes are released here, shared ones stay with their owners
+		physx::PxShape *shape;
+		while (body->getShapes(&shape, 1))
+			body->detachShape(*shape);
+		
+		actorPool.push_back(body);
+	}
+	else
+	{
+		actor->release();
+	}
 }
 
-physx::PxActor* World::addSphere(const float size, const ofVec3f& pos, const ofQuaternion& rot, float density)
+void World::applyKinematicTargets()
 {
-	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
-	rigid->createShape(physx::PxSphereGeometry(size), *defaultMaterial);
-	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+	{
+		Poco::FastMutex::ScopedLock lock(targetMutex);
+		if (stagedTargets.empty()) return;
+		stagedTargets.swap(appliedTargets);
+	}
+	
+	for (size_t i = 0; i < appliedTargets.size(); i++)
+	{
+		const KinematicTarget& target = appliedTargets[i];
+		
+		physx::PxRigidActor *actor = poses.resolve(target.handle);
+		if (!actor || !poses.isKinematic(PoseCache::getSlot(target.handle))) continue;
+		
+		// a body is only kinematic in the scene once its add is flushed
+		physx::PxRigidDynamic *body = actor->isRigidDynamic();
+		if (body->getScene())
+			body->setKinematicTarget(target.pose);
+	}
+	
+	// keeps its capacity for the next swap
+	appliedTargets.clear();
 }
 
-physx::PxActor* World::addCapsule(const float radius, const float height, const ofVec3f& pos, const ofQuaternion& rot, float density)
+void World::setActorPoolSize(size_t n)
 {
-	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
-	rigid->createShape(physx::PxCapsuleGeometry(radius, height / 2), *defaultMaterial);
-	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+	actorPoolSize = n;
+	
+	while (actorPool.size() > actorPoolSize)
+	{
+		actorPool.back()->release();
+		actorPool.pop_back();
+	}
 }
 
-physx::PxActor* World::addPlane(const ofVec3f& pos, const ofQuaternion& rot, float density)
+void World::setAllocationTracking(bool yn)
 {
-	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
-	rigid->createShape(physx::PxPlaneGeometry(), *defaultMaterial, physx::PxTransform(physx::PxVec3(0, 0, 0), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 0, 1))));
-	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+	if (physics)
+		ofLogWarning("ofxPhysX::World") << "allocation tracking takes effect at the next setup()";
+	
+	allocationTracking = yn;
 }
 
-physx::PxActor* World::addWorldBox(const ofVec3f &leftBottomFar, const ofVec3f& rightTopNear)
+void World::setScratchMemorySize(size_t bytes)
 {
-	physx::PxRigidActor *rigid = createRigid(ofVec3f(0, 0, 0), ofQuaternion(), 0);
+	waitForSimulation();
 	
-	physx::PxPlaneGeometry p;
-	p = physx::PxPlaneGeometry();
+	// PhysX wants a multiple of 16K
+	const size_t block = 16 * 1024;
+	bytes = (bytes + block - 1) / block * block;
+	
+	if (scratchBlock)
+		getAllocator().deallocate(scratchBlock);
+	scratchBlock = NULL;
+	
+	scratchSize = bytes;
+}
 
-	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(leftBottomFar.x, 0, 0),
-physx::PxQuat(ofDegToRad(0), physx::PxVec3(0, 0, 1))));
-	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(rightTopNear.x, 0, 0), physx::PxQuat(ofDegToRad(180), physx::PxVec3(0, 0, -1))));
+void World::setPipelined(bool yn)
+{
+	if (!yn) waitForSimulation();
+	pipelined = yn;
+}
 
-	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, leftBottomFar.y, 0), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 0, 1))));
-	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, rightTopNear.y, 0), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 0, -1))));
-	
-	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, 0, leftBottomFar.z), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, -1, 0))));
-	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, 0, rightTopNear.z), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 1, 0))));
+void World::setFixedTimestep(float step, int maxSubSteps_)
+{
+	fixedTimestep = step;
+	maxSubSteps = max(maxSubSteps_, 1);
+	accumulator = 0;
+	interpolationAlpha = 1;
+}
 
-	return updateMassAndInertia(rigid, 0);
+ofMatrix4x4 World::getInterpolatedTransform(const physx::PxRigidActor *actor) const
+{
+	assert(actor);
+	
+	physx::PxU32 slot = PoseCache::getSlot(actor);
+	if (slot == PoseCache::INVALID_SLOT)
+		return toOF(actor->getGlobalPose());
+	
+	return poses.getInterpolatedTransform(slot, interpolationAlpha);
+}
+
+void World::draw()
+{
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::World") << "call setup first";
+		return;
+	}
+	
+	if (!debugDraw) return;
+	
+	ScopedPhaseTimer timer(profiling(), WorldStats::DEBUG_DRAW);
+	
+	glPushAttrib(GL_ALL_ATTRIB_BITS);
+	glPushMatrix();
+	
+	debugRenderer.draw();
+	
+	glPopMatrix();
+	glPopAttrib();
+}
+
+void World::drawShapes()
+{
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::World") << "call setup first";
+		return;
+	}
+	
+	ScopedPhaseTimer timer(profiling(), WorldStats::SHAPE_DRAW);
+	
+	shapeRenderer.update(poses, interpolationAlpha);
+	shapeRenderer.draw();
+}
+
+void World::setStatsEnabled(bool yn)
+{
+	statsEnabled = yn;
+	if (!yn) stats.clear();
+}
+
+void World::setDebugDrawEnabled(bool yn)
+{
+	debugDraw = yn;
+	
+	if (!debugDraw)
+		debugRenderer.clear();
+	
+	if (!scene) return;
+	
+	waitForSimulation();
+	
+	// with a zero scale PhysX doesn't generate any debug geometry
+	physx::PxSceneWriteLock scopedLock(*scene);
+	scene->setVisualizationParameter(physx::PxVisualizationParameter::eSCALE, debugDraw ? WorldScale::getWorldScale() * 0.1f : 0.0f);
+}
+
+//
+
+physx::PxRigidActor* World::createRigid(const ofVec3f& pos, const ofQuaternion& rot, float density, bool kinematic)
+{
+	physx::PxRigidActor *actor = createRigidActor(pos, rot, density, kinematic);
+	
+	// joins the scene now, or once the step in flight is collected
+	pendingAdds.push_back(actor);
+	flushPendingActors();
+	
+	return actor;
+}
+
+physx::PxRigidActor* World::createRigidActor(const ofVec3f& pos, const ofQuaternion& rot, float density, bool kinematic)
+{
+	physx::PxTransform transform;
+	toPx(pos, transform.p);
+	toPx(rot, transform.q);
+	
+	physx::PxRigidActor *actor;
+	
+	if (density > 0 || kinematic)
+	{
+		physx::PxRigidDynamic* rigid;
+		
+		if (!actorPool.empty())
+		{
+			rigid = actorPool.back();
+			actorPool.pop_back();
+			
+			// back to the state of a new actor, mass is set by the caller
+			rigid->setGlobalPose(transform);
+			rigid->setLinearVelocity(physx::PxVec3(0, 0, 0));
+			rigid->setAngularVelocity(physx::PxVec3(0, 0, 0));
+			rigid->setRigidBodyFlags(physx::PxRigidBodyFlags());
+			rigid->setActorFlags(physx::PxActorFlag::eVISUALIZATION);
+			rigid->setContactReportThreshold(PX_MAX_F32);
+			rigid->setWakeCounter(0.4f);
+		}
+		else
+		{
+			rigid = physics->createRigidDynamic(transform);
+		}
+		
+		// before the scene sees the actor, so it never joins as a simulated body
+		if (kinematic)
+			rigid->setRigidBodyFlag(physx::PxRigidBodyFlag::eKINEMATIC, true);
+		
+		rigid->setLinearDamping(0.25);
+		rigid->setAngularDamping(0.25);
+		actor = rigid;
+	}
+	else
+	{
+		physx::PxRigidStatic *rigid = physics->createRigidStatic(transform);
+		actor = rigid;
+	}
+	
+	assert(actor);
+	
+	// the slot and handle are usable while the actor is queued
+	poses.add(actor);
+	
+	return actor;
+}
+
+physx::PxRigidActor* World::updateMassAndInertia(physx::PxRigidActor *rigid, float density)
+{
+	if (density <= 0) return rigid;
+	
+	physx::PxRigidBody *rigidbody = rigid->isRigidBody();
+	if (rigidbody)
+		physx::PxRigidBodyExt::updateMassAndInertia(*rigidbody, density);
+	
+	return rigid;
+}
+
+void World::removeActor(physx::PxActor *actor)
+{
+	if (!actor) return;
+	
+	physx::PxRigidActor *rigid = actor->isRigidActor();
+	if (rigid)
+		poses.remove(rigid);
+	
+	dropActor(actor);
+}
+
+size_t World::removeActors(const vector<PoseCache::Handle>& handles)
+{
+	size_t n = 0;
+	
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+		// stale and repeated handles stop resolving once their actor is gone
+		physx::PxRigidActor *rigid = poses.resolve(handles[i]);
+		if (!rigid) continue;
+		
+		poses.remove(rigid);
+		dropActor(rigid);
+		n++;
+	}
+	
+	return n;
+}
+
+bool World::saveSnapshot(const string& path)
+{
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::World") << "call setup first";
+		return false;
+	}
+	
+	waitForSimulation();
+	
+	physx::PxSerializationRegistry *registry = physx::PxSerialization::createSerializationRegistry(*physics);
+	physx::PxCollection *collection = physx::PxCollectionExt::createCollection(*scene);
+	
+	// pull in the shapes and materials the actors reference
+	physx::PxSerialization::complete(*collection, *registry);
+	
+	physx::PxDefaultMemoryOutputStream stream;
+	bool ok = physx::PxSerialization::serializeCollectionToBinary(stream, *collection, *registry);
+	
+	SnapshotHeader header;
+	for (physx::PxU32 i = 0; i < collection->getNbObjects(); i++)
+	{
+		if (collection->getObject(i).is<physx::PxRigidActor>())
+			header.numActors++;
+	}
+	header.dataSize = stream.getSize();
+	
+	collection->release();
+	registry->release();
+	
+	if (!ok)
+	{
+		ofLogError("ofxPhysX::World") << "can't serialize the scene";
+		return false;
+	}
+	
+	ofFile file(path, ofFile::WriteOnly, true);
+	if (!file.is_open())
+	{
+		ofLogError("ofxPhysX::World") << "can't open " << path;
+		return false;
+	}
+	
+	char block[SnapshotHeader::SNAPSHOT_ALIGNMENT];
+	memset(block, 0, sizeof(block));
+	memcpy(block, &header, sizeof(header));
+	
+	file.write(block, sizeof(block));
+	file.write((const char*)stream.getData(), stream.getSize());
+	
+	return file.good();
+}
+
+bool World::loadSnapshot(const string& path)
+{
+	if (!physics)
+	{
+		ofLogError("ofxPhysX::World") << "call setup first";
+		return false;
+	}
+	
+	waitForSimulation();
+	
+	MappedFile *file = new MappedFile;
+	if (!file->open(ofToDataPath(path, true)))
+	{
+		ofLogError("ofxPhysX::World") << "can't open " << path;
+		delete file;
+		return false;
+	}
+	
+	SnapshotHeader header;
+	if (file->size() >= sizeof(header))
+		memcpy(&header, file->getData(), sizeof(header));
+	
+	if (file->size() < sizeof(header) || !header.isValid(file->size()))
+	{
+		ofLogError("ofxPhysX::World") << path << " is not a snapshot of this PhysX version";
+		delete file;
+		return false;
+	}
+	
+	void *block = (char*)file->getData() + SnapshotHeader::SNAPSHOT_ALIGNMENT;
+	
+	physx::PxSerializationRegistry *registry = physx::PxSerialization::createSerializationRegistry(*physics);
+	physx::PxCollection *collection = physx::PxSerialization::createCollectionFromBinary(block, *registry);
+	registry->release();
+	
+	if (!collection)
+	{
+		ofLogError("ofxPhysX::World") << "can't deserialize " << path;
+		delete file;
+		return false;
+	}
+	
+	scene->addCollection(*collection);
+	
+	for (physx::PxU32 i = 0; i < collection->getNbObjects(); i++)
+	{
+		physx::PxBase &object = collection->getObject(i);
+		
+		if (physx::PxAggregate *aggregate = object.is<physx::PxAggregate>())
+		{
+			aggregates.push_back(aggregate);
+			continue;
+		}
+		
+		physx::PxRigidActor *rigid = object.is<physx::PxRigidActor>();
+		if (!rigid) continue;
+		
+		// userData still points into the saving World's bindings
+		physx::PxU32 slot = poses.add(rigid);
+		if (slot == PoseCache::INVALID_SLOT) continue;
+		
+		physx::PxShape *shape = poses.getShape(slot);
+		if (shape && shape->getQueryFilterData().word0)
+			poses.setGroup(slot, shape->getQueryFilterData().word0);
+	}
+	
+	collection->release();
+	snapshots.push_back(file);
+	
+	return true;
+}
+
+void World::checkpoint(Checkpoint& cp)
+{
+	waitForSimulation();
+	
+	cp.clear();
+	cp.accumulator = accumulator;
+	cp.interpolationAlpha = interpolationAlpha;
+	
+	const vector<physx::PxRigidDynamic*>& dynamics = poses.getDynamics();
+	
+	for (physx::PxU32 slot = 0; slot < dynamics.size(); slot++)
+	{
+		physx::PxRigidDynamic *body = dynamics[slot];
+		if (!body) continue;
+		
+		Checkpoint::BodyState s;
+		s.pose = body->getGlobalPose();
+		s.linearVelocity = body->getLinearVelocity();
+		s.angularVelocity = body->getAngularVelocity();
+		s.wakeCounter = body->getWakeCounter();
+		s.slot = slot;
+		s.flags = 0;
+		
+		if (body->getRigidBodyFlags() & physx::PxRigidBodyFlag::eKINEMATIC)
+			s.flags |= Checkpoint::BodyState::KINEMATIC;
+		else if (body->isSleeping())
+			s.flags |= Checkpoint::BodyState::ASLEEP;
+		
+		cp.states.push_back(s);
+		cp.handles.push_back(poses.getHandle(slot));
+	}
+}
+
+size_t World::restore(const Checkpoint& cp)
+{
+	waitForSimulation();
+	
+	size_t n = 0;
+	
+	for (size_t i = 0; i < cp.states.size(); i++)
+	{
+		const Checkpoint::BodyState& s = cp.states[i];
+		
+		if (!poses.isValid(cp.handles[i]))
+			continue;
+		
+		physx::PxRigidDynamic *body = poses.getDynamic(s.slot);
+		body->setGlobalPose(s.pose, false);
+		
+		if (!(s.flags & Checkpoint::BodyState::KINEMATIC))
+		{
+			// forces added since the checkpoint would otherwise apply on the next step
+			body->clearForce(physx::PxForceMode::eFORCE, false);
+			body->clearForce(physx::PxForceMode::eACCELERATION, false);
+			body->clearTorque(physx::PxForceMode::eFORCE, false);
+			body->clearTorque(physx::PxForceMode::eACCELERATION, false);
+			
+			body->setLinearVelocity(s.linearVelocity, false);
+			body->setAngularVelocity(s.angularVelocity, false);
+			
+			if (s.flags & Checkpoint::BodyState::ASLEEP)
+				body->putToSleep();
+			else
+				body->setWakeCounter(s.wakeCounter);
+		}
+		
+		poses.teleport(s.slot, s.pose);
+		n++;
+	}
+	
+	accumulator = cp.accumulator;
+	interpolationAlpha = cp.interpolationAlpha;
+	
+	return n;
+}
+
+void World::invalidateShapes(physx::PxRigidActor *actor)
+{
+	physx::PxU32 slot = PoseCache::getSlot(actor);
+	if (slot == PoseCache::INVALID_SLOT) return;
+	
+	poses.updateShape(slot);
+	shapeRenderer.invalidate(slot);
+}
+
+void World::setSize(physx::PxRigidActor *actor, const ofVec3f& size)
+{
+	setSizes(vector<PoseCache::Handle>(1, PoseCache::getHandle(actor)), vector<ofVec3f>(1, size));
+}
+
+size_t World::setSizes(const vector<PoseCache::Handle>& handles, const vector<ofVec3f>& sizes)
+{
+	if (!checkSize("sizes", sizes.size(), handles.size()))
+		return 0;
+	
+	waitForSimulation();
+	
+	resizedBounds.clear();
+	
+	for (size_t i = 0; i < handles.size(); i++)
+	{
+		physx::PxRigidActor *actor = poses.resolve(handles[i]);
+		if (!actor) continue;
+		
+		const physx::PxU32 slot = PoseCache::getSlot(handles[i]);
+		if (poses.getNumShapes(slot) != 1)
+		{
+			ofLogWarning("ofxPhysX::World") << "setSizes: only single shape actors can be resized";
+			continue;
+		}
+		
+		physx::PxShape *shape = poses.getShape(slot);
+		physx::PxBounds3 bounds = physx::PxShapeExt::getWorldBounds(*shape, *actor);
+		const physx::PxGeometryHolder before = shape->getGeometry();
+		
+		// shapes from the bulk creators are shared
+		shape = makeExclusive(actor, shape);
+		if (!setGeometrySize(shape, sizes[sizes.size() == 1 ? 0 : i])) continue;
+		
+		physx::PxRigidBody *body = actor->isRigidBody();
+		if (body)
+			updateMass(body, before.any(), shape);
+		
+		// bodies resting on a shrinking shape need waking as much as the ones it grows into
+		bounds.include(physx::PxShapeExt::getWorldBounds(*shape, *actor));
+		resizedBounds.push_back(bounds);
+		
+		shapeRenderer.invalidate(slot);
+	}
+	
+	wakeTouching(resizedBounds);
+	
+	return resizedBounds.size();
+}
+
+bool World::setGeometrySize(physx::PxShape *shape, const ofVec3f& size)
+{
+	physx::PxGeometryType::Enum t = shape->getGeometryType();
+	if (t == physx::PxGeometryType::eSPHERE)
+	{
+		shape->setGeometry(physx::PxSphereGeometry(size.x));
+	}
+	else if (t == physx::PxGeometryType::eCAPSULE)
+	{
+		// getSize() reports the full height
+		shape->setGeometry(physx::PxCapsuleGeometry(size.x, size.y / 2));
+	}
+	else if (t == physx::PxGeometryType::eBOX)
+	{
+		shape->setGeometry(physx::PxBoxGeometry(toPx(size / 2)));
+	}
+	else if (t == physx::PxGeometryType::eCONVEXMESH)
+	{
+		physx::PxConvexMeshGeometry g;
+		shape->getConvexMeshGeometry(g);
+		g.scale.scale = toPx(size);
+		shape->setGeometry(g);
+	}
+	else if (t == physx::PxGeometryType::eTRIANGLEMESH)
+	{
+		physx::PxTriangleMeshGeometry g;
+		shape->getTriangleMeshGeometry(g);
+		g.scale.scale = toPx(size);
+		shape->setGeometry(g);
+	}
+	else if (t == physx::PxGeometryType::eHEIGHTFIELD)
+	{
+		physx::PxHeightFieldGeometry g;
+		shape->getHeightFieldGeometry(g);
+		g.rowScale = size.x;
+		g.heightScale = size.y / MAX_HEIGHT_SAMPLE;
+		g.columnScale = size.z;
+		shape->setGeometry(g);
+	}
+	else
+	{
+		ofLogWarning("ofxPhysX::World") << "setGeometrySize: unimplemented shape type";
+		return false;
+	}
+	
+	return true;
+}
+
+void World::wakeTouching(const vector<physx::PxBounds3>& bounds)
+{
+	if (bounds.empty()) return;
+	
+	const physx::PxU32 maxTouches = 256;
+	vector<physx::PxOverlapHit> touches(maxTouches);
+	
+	// a contact offset of margin, so bodies just resting on the shape are found
+	const float margin = physics->getTolerancesScale().length * 0.02f;
+	const physx::PxQueryFilterData filter(physx::PxQueryFlag::eDYNAMIC | physx::PxQueryFlag::eNO_BLOCK);
+	
+	for (size_t i = 0; i < bounds.size(); i++)
+	{
+		const physx::PxBoxGeometry box(bounds[i].getExtents() + physx::PxVec3(margin));
+		
+		physx::PxOverlapBuffer buffer(touches.data(), maxTouches);
+		scene->overlap(box, physx::PxTransform(bounds[i].getCenter()), buffer, filter);
+		
+		for (physx::PxU32 k = 0; k < buffer.nbTouches; k++)
+		{
+			physx::PxRigidDynamic *body = buffer.touches[k].actor->isRigidDynamic();
+			if (body && body->isSleeping() && !(body->getRigidBodyFlags() & physx::PxRigidBodyFlag::eKINEMATIC))
+				body->wakeUp();
+		}
+	}
+}
+
+physx::PxRigidDynamic* World::setKinematic(physx::PxRigidActor *actor, bool yn)
+{
+	waitForSimulation();
+	
+	physx::PxRigidDynamic *body = actor->isRigidDynamic();
+	if (body)
+	{
+		body->setRigidBodyFlag(physx::PxRigidBodyFlag::eKINEMATIC, yn);
+		if (!yn) body->wakeUp();
+		
+		physx::PxU32 slot = PoseCache::getSlot(body);
+		if (slot != PoseCache::INVALID_SLOT)
+			poses.setKinematic(slot, yn);
+		
+		return body;
+	}
+	
+	if (!yn) return NULL;
+	
+	// statics can't be switched, so a kinematic body takes over copies of the shapes
+	physx::PxRigidDynamic *kinematic = physics->createRigidDynamic(actor->getGlobalPose());
+	kinematic->setRigidBodyFlag(physx::PxRigidBodyFlag::eKINEMATIC, true);
+	
+	const physx::PxU32 n = actor->getNbShapes();
+	vector<physx::PxShape*> shapes(n);
+	actor->getShapes(shapes.data(), n);
+	
+	for (physx::PxU32 i = 0; i < n; i++)
+		copyShape(shapes[i], kinematic);
+	
+	const physx::PxU32 group = getGroup(actor);
+	removeActor(actor);
+	
+	physx::PxU32 slot = poses.add(kinematic);
+	if (slot != PoseCache::INVALID_SLOT)
+		poses.setGroup(slot, group);
+	
+	pendingAdds.push_back(kinematic);
+	flushPendingActors();
+	
+	return kinematic;
+}
+
+physx::PxActor* World::addKinematicBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, 0, true);
+	rigid->createShape(physx::PxBoxGeometry(toPx(size / 2)), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addKinematicSphere(const float size, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, 0, true);
+	rigid->createShape(physx::PxSphereGeometry(size), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addKinematicCapsule(const float radius, const float height, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, 0, true);
+	rigid->createShape(physx::PxCapsuleGeometry(radius, height / 2), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, WorldScale::getInvDensityScale());
+}
+
+void World::setKinematicTarget(PoseCache::Handle handle, const ofVec3f& pos, const ofQuaternion& rot)
+{
+	KinematicTarget target;
+	target.handle = handle;
+	toPx(pos, target.pose.p);
+	toPx(rot, target.pose.q);
+	
+	Poco::FastMutex::ScopedLock lock(targetMutex);
+	stagedTargets.push_back(target);
+}
+
+void World::setKinematicTargets(const PoseCache::Handle *handles, const physx::PxTransform *targets, size_t count)
+{
+	Poco::FastMutex::ScopedLock lock(targetMutex);
+	
+	const size_t offset = stagedTargets.size();
+	stagedTargets.resize(offset + count);
+	
+	for (size_t i = 0; i < count; i++)
+	{
+		stagedTargets[offset + i].handle = handles[i];
+		stagedTargets[offset + i].pose = targets[i];
+	}
+}
+
+void World::setGroup(physx::PxRigidActor *actor, physx::PxU32 group, physx::PxU32 mask)
+{
+	// actors still queued for the scene can be changed during a step
+	if (actor->getScene())
+		waitForSimulation();
+	
+	physx::PxU32 slot = PoseCache::getSlot(actor);
+	if (slot != PoseCache::INVALID_SLOT)
+		poses.setGroup(slot, group);
+	
+	const physx::PxU32 n = actor->getNbShapes();
+	vector<physx::PxShape*> shapes(n);
+	actor->getShapes(shapes.data(), n);
+	
+	bool changed = false;
+	
+	for (physx::PxU32 i = 0; i < n; i++)
+	{
+		physx::PxShape *shape = shapes[i];
+		
+		physx::PxFilterData simData = shape->getSimulationFilterData();
+		physx::PxFilterData queryData = shape->getQueryFilterData();
+		if (simData.word0 == group && simData.word1 == mask && queryData.word0 == group) continue;
+		
+		if (!shape->isExclusive())
+			shape = makeExclusive(actor, shape);
+		
+		simData.word0 = group;
+		simData.word1 = mask;
+		shape->setSimulationFilterData(simData);
+		
+		// scene queries filter on the query data
+		queryData.word0 = group;
+		shape->setQueryFilterData(queryData);
+		
+		changed = true;
+	}
+	
+	// also picks up the shapes attached since the actor was added
+	if (slot != PoseCache::INVALID_SLOT)
+		poses.updateShape(slot);
+	
+	if (changed && actor->getScene())
+		scene->resetFiltering(*actor);
+}
+
+void World::setSuppressedGroups(physx::PxU32 groups)
+{
+	filterSettings.suppressedGroups = groups;
+	
+	if (!scene) return;
+	
+	waitForSimulation();
+	scene->setFilterShaderData(&filterSettings, sizeof(filterSettings));
+}
+
+physx::PxShape* World::makeExclusive(physx::PxRigidActor *actor, physx::PxShape *shape)
+{
+	if (shape->isExclusive()) return shape;
+	
+	physx::PxShape *copy = copyShape(shape, actor);
+	actor->detachShape(*shape);
+	
+	// keep the shape cached by the owning World current
+	World *world = getWorld(actor);
+	physx::PxU32 slot = PoseCache::getSlot(actor);
+	if (world && slot != PoseCache::INVALID_SLOT)
+		world->poses.updateShape(slot);
+	
+	return copy;
+}
+
+void World::setEventReporting(physx::PxRigidActor *actor, physx::PxU32 report, float forceThreshold)
+{
+	waitForSimulation();
+	
+	physx::PxRigidDynamic *body = actor->isRigidDynamic();
+	if (forceThreshold > 0 && !body)
+	{
+		ofLogWarning("ofxPhysX::World") << "contact force thresholds only apply to dynamic actors";
+		forceThreshold = 0;
+	}
+	
+	if (body)
+		body->setContactReportThreshold(forceThreshold > 0 ? forceThreshold : PX_MAX_F32);
+	
+	// nonzero bits switch the pair to PhysX's force threshold flags
+	physx::PxU32 thresholdBits = 0;
+	if (forceThreshold > 0)
+		memcpy(&thresholdBits, &forceThreshold, sizeof(float));
+	
+	const physx::PxU32 n = actor->getNbShapes();
+	vector<physx::PxShape*> shapes(n);
+	actor->getShapes(shapes.data(), n);
+	
+	for (physx::PxU32 i = 0; i < n; i++)
+	{
+		physx::PxShape *shape = makeExclusive(actor, shapes[i]);
+		
+		physx::PxFilterData data = shape->getSimulationFilterData();
+		data.word2 = report;
+		data.word3 = thresholdBits;
+		shape->setSimulationFilterData(data);
+	}
+	
+	actor->setActorFlag(physx::PxActorFlag::eSEND_SLEEP_NOTIFIES, (report & Event::REPORT_SLEEP_WAKE) != 0);
+	
+	// pairs that already exist keep their old flags otherwise
+	if (actor->getScene())
+		scene->resetFiltering(*actor);
+}
+
+void World::setTrigger(physx::PxRigidActor *actor, bool yn)
+{
+	waitForSimulation();
+	
+	const physx::PxU32 n = actor->getNbShapes();
+	vector<physx::PxShape*> shapes(n);
+	actor->getShapes(shapes.data(), n);
+	
+	for (physx::PxU32 i = 0; i < n; i++)
+	{
+		physx::PxShape *shape = makeExclusive(actor, shapes[i]);
+		
+		// a shape can't be both a trigger and a simulation shape
+		if (yn)
+		{
+			shape->setFlag(physx::PxShapeFlag::eSIMULATION_SHAPE, false);
+			shape->setFlag(physx::PxShapeFlag::eTRIGGER_SHAPE, true);
+		}
+		else
+		{
+			shape->setFlag(physx::PxShapeFlag::eTRIGGER_SHAPE, false);
+			shape->setFlag(physx::PxShapeFlag::eSIMULATION_SHAPE, true);
+		}
+	}
+}
+
+physx::PxU32 World::getGroup(const physx::PxRigidActor *actor) const
+{
+	physx::PxU32 slot = PoseCache::getSlot(actor);
+	return slot != PoseCache::INVALID_SLOT ? poses.getGroup(slot) : 0;
+}
+
+void World::setGravity(ofVec3f gravity)
+{
+	waitForSimulation();
+	scene->setGravity(toPx(gravity));
+}
+
+//
+
+physx::PxActor* World::addBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
+	rigid->createShape(physx::PxBoxGeometry(toPx(size / 2)), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addSphere(const float size, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
+	rigid->createShape(physx::PxSphereGeometry(size), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addCapsule(const float radius, const float height, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
+	rigid->createShape(physx::PxCapsuleGeometry(radius, height / 2), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addPlane(const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
+	rigid->createShape(physx::PxPlaneGeometry(), *defaultMaterial, physx::PxTransform(physx::PxVec3(0, 0, 0), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 0, 1))));
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addConvexMesh(const ofMesh& mesh, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxConvexMesh *convex = meshCooker.createConvexMesh(mesh);
+	if (!convex) return NULL;
+	
+	return addConvexMesh(convex, pos, rot, density, group, mask);
+}
+
+physx::PxActor* World::addConvexMesh(physx::PxConvexMesh *mesh, const ofVec3f& pos, const ofQuaternion& rot, float density, physx::PxU32 group, physx::PxU32 mask)
+{
+	if (!mesh) return NULL;
+	
+	physx::PxRigidActor *rigid = createRigid(pos, rot, density * WorldScale::getInvDensityScale());
+	rigid->createShape(physx::PxConvexMeshGeometry(mesh), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return updateMassAndInertia(rigid, density * WorldScale::getInvDensityScale());
+}
+
+physx::PxActor* World::addTriangleMesh(const ofMesh& mesh, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	physx::PxTriangleMesh *triangles = meshCooker.createTriangleMesh(mesh);
+	if (!triangles) return NULL;
+	
+	return addTriangleMesh(triangles, pos, rot, group, mask);
+}
+
+physx::PxActor* World::addTriangleMesh(physx::PxTriangleMesh *mesh, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	if (!mesh) return NULL;
+	
+	// PhysX only simulates triangle meshes on static and kinematic actors
+	physx::PxRigidActor *rigid = createRigid(pos, rot, 0);
+	rigid->createShape(physx::PxTriangleMeshGeometry(mesh), *defaultMaterial);
+	setGroup(rigid, group, mask);
+	return rigid;
+}
+
+physx::PxActor* World::addHeightField(const ofFloatPixels& pixels, const ofVec3f& scale, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	vector<physx::PxHeightFieldSample> samples;
+	toHeightSamples(pixels, samples);
+	return addHeightField(samples, pixels.getWidth(), pixels.getHeight(), scale, pos, rot, group, mask);
+}
+
+physx::PxActor* World::addHeightField(const ofShortPixels& pixels, const ofVec3f& scale, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	vector<physx::PxHeightFieldSample> samples;
+	toHeightSamples(pixels, samples);
+	return addHeightField(samples, pixels.getWidth(), pixels.getHeight(), scale, pos, rot, group, mask);
+}
+
+physx::PxActor* World::addHeightField(const vector<physx::PxHeightFieldSample>& samples, int width, int height, const ofVec3f& scale, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask)
+{
+	if (width < 2 || height < 2)
+	{
+		ofLogError("ofxPhysX::World") << "height fields need at least 2x2 samples";
+		return NULL;
+	}
+	
+	physx::PxHeightFieldDesc desc;
+	desc.format = physx::PxHeightFieldFormat::eS16_TM;
+	desc.nbRows = width;
+	desc.nbColumns = height;
+	desc.samples.data = samples.data();
+	desc.samples.stride = sizeof(physx::PxHeightFieldSample);
+	
+	physx::PxHeightField *field = physics->createHeightField(desc);
+	if (!field)
+	{
+		ofLogError("ofxPhysX::World") << "can't create the height field";
+		return NULL;
+	}
+	
+	physx::PxHeightFieldGeometry geometry(field, physx::PxMeshGeometryFlags(), scale.y / MAX_HEIGHT_SAMPLE, scale.x, scale.z);
+	
+	physx::PxRigidActor *rigid = createRigid(pos, rot, 0);
+	rigid->createShape(geometry, *defaultMaterial);
+	setGroup(rigid, group, mask);
+	
+	// the shape keeps the height field alive
+	field->release();
+	
+	return rigid;
+}
+
+bool World::modifyHeightField(physx::PxRigidActor *actor, const ofFloatPixels& pixels, int x, int y)
+{
+	vector<physx::PxHeightFieldSample> samples;
+	toHeightSamples(pixels, samples);
+	return modifyHeightField(actor, samples, pixels.getWidth(), pixels.getHeight(), x, y);
+}
+
+bool World::modifyHeightField(physx::PxRigidActor *actor, const ofShortPixels& pixels, int x, int y)
+{
+	vector<physx::PxHeightFieldSample> samples;
+	toHeightSamples(pixels, samples);
+	return modifyHeightField(actor, samples, pixels.getWidth(), pixels.getHeight(), x, y);
+}
+
+bool World::modifyHeightField(physx::PxRigidActor *actor, const vector<physx::PxHeightFieldSample>& samples, int width, int height, int x, int y)
+{
+	assert(actor);
+	
+	physx::PxShape *shape = NULL;
+	actor->getShapes(&shape, 1);
+	
+	if (!shape || shape->getGeometryType() != physx::PxGeometryType::eHEIGHTFIELD)
+	{
+		ofLogError("ofxPhysX::World") << "not a height field actor";
+		return false;
+	}
+	
+	waitForSimulation();
+	
+	physx::PxHeightFieldGeometry geometry;
+	shape->getHeightFieldGeometry(geometry);
+	
+	physx::PxHeightFieldDesc desc;
+	desc.format = physx::PxHeightFieldFormat::eS16_TM;
+	desc.nbRows = width;
+	desc.nbColumns = height;
+	desc.samples.data = samples.data();
+	desc.samples.stride = sizeof(physx::PxHeightFieldSample);
+	
+	// rows are x, columns are y
+	if (!geometry.heightField->modifySamples(y, x, desc, true))
+	{
+		ofLogError("ofxPhysX::World") << "modifySamples failed";
+		return false;
+	}
+	
+	// setting the geometry again refreshes the bounds the scene keeps
+	shape->setGeometry(geometry);
+	
+	return true;
+}
+
+physx::PxActor* World::addWorldBox(const ofVec3f &leftBottomFar, const ofVec3f& rightTopNear)
+{
+	physx::PxRigidActor *rigid = createRigid(ofVec3f(0, 0, 0), ofQuaternion(), 0);
+	
+	physx::PxPlaneGeometry p;
+	p = physx::PxPlaneGeometry();
+
+	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(leftBottomFar.x, 0, 0),
+physx::PxQuat(ofDegToRad(0), physx::PxVec3(0, 0, 1))));
+	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(rightTopNear.x, 0, 0), physx::PxQuat(ofDegToRad(180), physx::PxVec3(0, 0, -1))));
+
+	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, leftBottomFar.y, 0), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 0, 1))));
+	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, rightTopNear.y, 0), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 0, -1))));
+	
+	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, 0, leftBottomFar.z), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, -1, 0))));
+	rigid->createShape(p, *defaultMaterial, physx::PxTransform(physx::PxVec3(0, 0, rightTopNear.z), physx::PxQuat(ofDegToRad(90), physx::PxVec3(0, 1, 0))));
+	
+	setGroup(rigid, DEFAULT_GROUP);
+	return updateMassAndInertia(rigid, 0);
+}
+
+// bulk
+
+vector<physx::PxActor*> World::addBoxes(const vector<ofVec3f>& sizes, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations, float density, bool aggregate, physx::PxU32 group, physx::PxU32 mask)
+{
+	if (!checkSize("sizes", sizes.size(), positions.size()) || !checkSize("rotations", rotations.size(), positions.size(), true))
+		return vector<physx::PxActor*>();
+	
+	vector<physx::PxShape*> shapes(positions.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		const ofVec3f& size = sizes[sizes.size() == 1 ? 0 : i];
+		shapes[i] = getSharedShape(physx::PxBoxGeometry(toPx(size / 2)), group, mask);
+	}
+	
+	return addRigids(shapes, positions, rotations, density, aggregate, group);
+}
+
+vector<physx::PxActor*> World::addSpheres(const vector<float>& sizes, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations, float density, bool aggregate, physx::PxU32 group, physx::PxU32 mask)
+{
+	if (!checkSize("sizes", sizes.size(), positions.size()) || !checkSize("rotations", rotations.size(), positions.size(), true))
+		return vector<physx::PxActor*>();
+	
+	vector<physx::PxShape*> shapes(positions.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		float size = sizes[sizes.size() == 1 ? 0 : i];
+		shapes[i] = getSharedShape(physx::PxSphereGeometry(size), group, mask);
+	}
+	
+	return addRigids(shapes, positions, rotations, density, aggregate, group);
+}
+
+vector<physx::PxActor*> World::addCapsules(const vector<float>& radii, const vector<float>& heights, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations, float density, bool aggregate, physx::PxU32 group, physx::PxU32 mask)
+{
+	if (!checkSize("radii", radii.size(), positions.size()) || !checkSize("heights", heights.size(), positions.size()) || !checkSize("rotations", rotations.size(), positions.size(), true))
+		return vector<physx::PxActor*>();
+	
+	vector<physx::PxShape*> shapes(positions.size());
+	for (size_t i = 0; i < shapes.size(); i++)
+	{
+		float radius = radii[radii.size() == 1 ? 0 : i];
+		float height = heights[heights.size() == 1 ? 0 : i];
+		shapes[i] = getSharedShape(physx::PxCapsuleGeometry(radius, height / 2), group, mask);
+	}
+	
+	return addRigids(shapes, positions, rotations, density, aggregate, group);
+}
+
+physx::PxShape* World::getSharedShape(const physx::PxGeometry& geometry, physx::PxU32 group, physx::PxU32 mask)
+{
+	ShapeKey key;
+	key.type = geometry.getType();
+	key.a = key.b = key.c = 0;
+	key.group = group;
+	key.mask = mask;
+	
+	if (key.type == physx::PxGeometryType::eBOX)
+	{
+		const physx::PxBoxGeometry& g = static_cast<const physx::PxBoxGeometry&>(geometry);
+		key.a = g.halfExtents.x;
+		key.b = g.halfExtents.y;
+		key.c = g.halfExtents.z;
+	}
+	else if (key.type == physx::PxGeometryType::eSPHERE)
+	{
+		const physx::PxSphereGeometry& g = static_cast<const physx::PxSphereGeometry&>(geometry);
+		key.a = g.radius;
+	}
+	else if (key.type == physx::PxGeometryType::eCAPSULE)
+	{
+		const physx::PxCapsuleGeometry& g = static_cast<const physx::PxCapsuleGeometry&>(geometry);
+		key.a = g.radius;
+		key.b = g.halfHeight;
+	}
+	
+	map<ShapeKey, physx::PxShape*>::iterator it = sharedShapes.find(key);
+	if (it != sharedShapes.end())
+		return it->second;
+	
+	physx::PxShape *shape = physics->createShape(geometry, *defaultMaterial, false);
+	assert(shape);
+	
+	shape->setSimulationFilterData(physx::PxFilterData(group, mask, 0, 0));
+	shape->setQueryFilterData(physx::PxFilterData(group, 0, 0, 0));
+	
+	sharedShapes[key] = shape;
+	return shape;
+}
+
+vector<physx::PxActor*> World::addRigids(const vector<physx::PxShape*>& shapes, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations, float density, bool aggregate, physx::PxU32 group)
+{
+	if (shapes.size() != positions.size() || !checkSize("rotations", rotations.size(), positions.size(), true))
+		return vector<physx::PxActor*>();
+	
+	density *= WorldScale::getInvDensityScale();
+	
+	const ofQuaternion identity;
+	
+	// mass properties are computed once for each distinct shape
+	map<physx::PxShape*, physx::PxRigidBody*> prototypes;
+	
+	vector<physx::PxActor*> actors(positions.size());
+	
+	for (size_t i = 0; i < actors.size(); i++)
+	{
+		const ofQuaternion& rot = rotations.empty() ? identity : rotations[rotations.size() == 1 ? 0 : i];
+		
+		physx::PxRigidActor *rigid = createRigidActor(positions[i], rot, density);
+		rigid->attachShape(*shapes[i]);
+		
+		physx::PxRigidBody *body = density > 0 ? rigid->isRigidBody() : NULL;
+		if (body)
+		{
+			map<physx::PxShape*, physx::PxRigidBody*>::iterator it = prototypes.find(shapes[i]);
+			if (it == prototypes.end())
+			{
+				updateMassAndInertia(rigid, density);
+				prototypes[shapes[i]] = body;
+			}
+			else
+			{
+				physx::PxRigidBody *proto = it->second;
+				body->setCMassLocalPose(proto->getCMassLocalPose());
+				body->setMass(proto->getMass());
+				body->setMassSpaceInertiaTensor(proto->getMassSpaceInertiaTensor());
+			}
+		}
+		
+		actors[i] = rigid;
+	}
+	
+	insertActors(actors, aggregate, group);
+	
+	return actors;
+}
+
+void World::insertActors(vector<physx::PxActor*>& actors, bool aggregate, physx::PxU32 group)
+{
+	if (aggregate)
+	{
+		for (size_t i = 0; i < actors.size(); i += MAX_AGGREGATE_SIZE)
+		{
+			physx::PxU32 n = min(actors.size() - i, (size_t)MAX_AGGREGATE_SIZE);
+			
+			physx::PxAggregate *agg = physics->createAggregate(n, false);
+			assert(agg);
+			
+			for (physx::PxU32 k = 0; k < n; k++)
+				agg->addActor(*actors[i + k]);
+			
+			pendingAggregates.push_back(agg);
+		}
+	}
+	else
+	{
+		pendingAdds.insert(pendingAdds.end(), actors.begin(), actors.end());
+	}
+	
+	// one batch now, or once the step in flight is collected
+	flushPendingActors();
+	
+	// slots were taken by createRigidActor(), the shapes came after
+	for (size_t i = 0; i < actors.size(); i++)
+	{
+		physx::PxU32 slot = PoseCache::getSlot(actors[i]);
+		if (slot == PoseCache::INVALID_SLOT) continue;
+		
+		poses.updateShape(slot);
+		poses.setGroup(slot, group);
+	}
+}
+
+physx::PxActor* World::addCompound(const CompoundBuilder& compound, const ofVec3f& pos, const ofQuaternion& rot)
+{
+	return addCompounds(compound, vector<ofVec3f>(1, pos), vector<ofQuaternion>(1, rot)).front();
+}
+
+vector<physx::PxActor*> World::addCompounds(const CompoundBuilder& compound, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations, bool aggregate)
+{
+	if (!checkSize("rotations", rotations.size(), positions.size(), true))
+		return vector<physx::PxActor*>();
+	
+	if (compound.getWorld() != this)
+	{
+		ofLogError("ofxPhysX::World") << "build the compound for this World first";
+		return vector<physx::PxActor*>(positions.size(), (physx::PxActor*)NULL);
+	}
+	
+	const ofQuaternion identity;
+	
+	vector<physx::PxActor*> actors(positions.size());
+	for (size_t i = 0; i < actors.size(); i++)
+	{
+		const ofQuaternion& rot = rotations.empty() ? identity : rotations[rotations.size() == 1 ? 0 : i];
+		actors[i] = createCompoundActor(compound, positions[i], rot);
+	}
+	
+	insertActors(actors, aggregate, compound.group);
+	
+	return actors;
+}
+
+physx::PxRigidActor* World::createCompoundActor(const CompoundBuilder& compound, const ofVec3f& pos, const ofQuaternion& rot)
+{
+	physx::PxRigidActor *rigid = createRigidActor(pos, rot, compound.mass);
+	
+	for (size_t i = 0; i < compound.shapes.size(); i++)
+		rigid->attachShape(*compound.shapes[i]);
+	
+	// precomputed by CompoundBuilder::build()
+	physx::PxRigidBody *body = rigid->isRigidBody();
+	if (body)
+	{
+		body->setCMassLocalPose(compound.massFrame);
+		body->setMass(compound.mass);
+		body->setMassSpaceInertiaTensor(compound.inertia);
+	}
+	
+	return rigid;
+}
+
+// queries
+
+// PhysX expects unit directions, a zero vector can't be normalized
+static inline bool hasDirection(const ofVec3f& direction)
+{
+	return direction.lengthSquared() > 0;
+}
+
+bool World::raycast(const ofVec3f& origin, const ofVec3f& direction, float distance, QueryHit& hit, physx::PxU32 mask) const
+{
+	hit = QueryHit();
+	if (!hasDirection(direction)) return false;
+	
+	physx::PxRaycastBuffer buffer;
+	scene->raycast(toPx(origin), toPx(direction.getNormalized()), distance, buffer, physx::PxHitFlag::eDEFAULT, toFilterData(mask));
+	
+	if (!buffer.hasBlock) return false;
+	
+	toQueryHit(buffer.block, hit);
+	return true;
+}
+
+bool World::raycast(const Raycast& query, QueryHit& hit) const
+{
+	return raycast(query.origin, query.direction, query.distance, hit, query.mask);
+}
+
+bool World::sweep(const Sweep& query, QueryHit& hit) const
+{
+	hit = QueryHit();
+	if (!hasDirection(query.direction)) return false;
+	
+	physx::PxSweepBuffer buffer;
+	physx::PxTransform pose(toPx(query.position), toPx(query.rotation));
+	scene->sweep(query.geometry.any(), pose, toPx(query.direction.getNormalized()), query.distance, buffer, physx::PxHitFlag::eDEFAULT, toFilterData(query.mask));
+	
+	if (!buffer.hasBlock) return false;
+	
+	toQueryHit(buffer.block, hit);
+	return true;
+}
+
+size_t World::overlap(const Overlap& query, vector<physx::PxRigidActor*>& result, physx::PxU32 maxTouches) const
+{
+	// local, so concurrent queries don't share a buffer
+	vector<physx::PxOverlapHit> touches(maxTouches);
+	
+	physx::PxOverlapBuffer buffer(touches.data(), maxTouches);
+	physx::PxTransform pose(toPx(query.position), toPx(query.rotation));
+	scene->overlap(query.geometry.any(), pose, buffer, toFilterData(query.mask, physx::PxQueryFlag::eSTATIC | physx::PxQueryFlag::eDYNAMIC | physx::PxQueryFlag::eNO_BLOCK));
+	
+	result.resize(buffer.nbTouches);
+	for (physx::PxU32 i = 0; i < buffer.nbTouches; i++)
+		result[i] = buffer.touches[i].actor;
+	
+	return result.size();
+}
+
+namespace
+{
+	class BatchQueryJob : public ParallelJob
+	{
+	public:
+		
+		BatchQueryJob() :
+			contexts(NULL),
+			nextContext(0),
+			raycasts(NULL),
+			sweeps(NULL),
+			overlaps(NULL),
+			hits(NULL),
+			touches(NULL),
+			counts(NULL),
+			maxTouches(0)
+		{}
+		
+		void execute(size_t begin, size_t end)
+		{
+			// every concurrently running chunk gets its own PxBatchQuery
+			BatchQueryContext& context = (*contexts)[nextContext++];
+			
+			for (size_t b = begin; b < end; b += BatchQueryContext::BATCH_SIZE)
+				run(context, b, min(end, b + BatchQueryContext::BATCH_SIZE));
+		}
+		
+		void run(BatchQueryContext& context, size_t begin, size_t end)
+		{
+			const physx::PxU32 n = end - begin;
+			
+			physx::PxBatchQueryMemory memory(raycasts ? n : 0, sweeps ? n : 0, overlaps ? n : 0);
+			
+			if (raycasts)
+			{
+				context.raycastResults.resize(n);
+				memory.userRaycastResultBuffer = context.raycastResults.data();
+			}
+			else if (sweeps)
+			{
+				context.sweepResults.resize(n);
+				memory.userSweepResultBuffer = context.sweepResults.data();
+			}
+			else if (overlaps)
+			{
+				context.overlapResults.resize(n);
+				context.overlapTouches.resize(n * maxTouches);
+				memory.userOverlapResultBuffer = context.overlapResults.data();
+				memory.userOverlapTouchBuffer = context.overlapTouches.data();
+				memory.overlapTouchBufferSize = n * maxTouches;
+			}
+			
+			physx::PxBatchQuery *query = context.query;
+			query->setUserMemory(memory);
+			
+			// queries without a direction aren't submitted, results are read back in
+			// submission order so the same test skips them below
+			for (size_t i = begin; i < end; i++)
+			{
+				if (raycasts)
+				{
+					const Raycast& q = raycasts[i];
+					if (!hasDirection(q.direction)) continue;
+					query->raycast(toPx(q.origin), toPx(q.direction.getNormalized()), q.distance, 0, physx::PxHitFlag::eDEFAULT, toFilterData(q.mask));
+				}
+				else if (sweeps)
+				{
+					const Sweep& q = sweeps[i];
+					if (!hasDirection(q.direction)) continue;
+					physx::PxTransform pose(toPx(q.position), toPx(q.rotation));
+					query->sweep(q.geometry.any(), pose, toPx(q.direction.getNormalized()), q.distance, 0, physx::PxHitFlag::eDEFAULT, toFilterData(q.mask));
+				}
+				else if (overlaps)
+				{
+					const Overlap& q = overlaps[i];
+					physx::PxTransform pose(toPx(q.position), toPx(q.rotation));
+					query->overlap(q.geometry.any(), pose, maxTouches, toFilterData(q.mask, physx::PxQueryFlag::eSTATIC | physx::PxQueryFlag::eDYNAMIC | physx::PxQueryFlag::eNO_BLOCK));
+				}
+			}
+			
+			query->execute();
+			
+			physx::PxU32 submitted = 0;
+			for (physx::PxU32 i = 0; i < n; i++)
+			{
+				if (raycasts)
+				{
+					QueryHit& hit = hits[begin + i];
+					hit = QueryHit();
+					if (!hasDirection(raycasts[begin + i].direction)) continue;
+					
+					const physx::PxRaycastQueryResult& r = context.raycastResults[submitted++];
+					if (r.queryStatus == physx::PxBatchQueryStatus::eSUCCESS && r.hasBlock)
+						toQueryHit(r.block, hit);
+				}
+				else if (sweeps)
+				{
+					QueryHit& hit = hits[begin + i];
+					hit = QueryHit();
+					if (!hasDirection(sweeps[begin + i].direction)) continue;
+					
+					const physx::PxSweepQueryResult& r = context.sweepResults[submitted++];
+					if (r.queryStatus == physx::PxBatchQueryStatus::eSUCCESS && r.hasBlock)
+						toQueryHit(r.block, hit);
+				}
+				else if (overlaps)
+				{
+					const physx::PxOverlapQueryResult& r = context.overlapResults[i];
+					physx::PxRigidActor **dst = touches + (begin + i) * maxTouches;
+					
+					physx::PxU32 count = r.queryStatus == physx::PxBatchQueryStatus::eSUCCESS ? min(r.nbTouches, maxTouches) : 0;
+					for (physx::PxU32 k = 0; k < count; k++)
+						dst[k] = r.touches[k].actor;
+					
+					counts[begin + i] = count;
+				}
+			}
+		}
+		
+		vector<BatchQueryContext> *contexts;
+		Poco::AtomicCounter nextContext;
+		
+		const Raycast *raycasts;
+		const Sweep *sweeps;
+		const Overlap *overlaps;
+		
+		QueryHit *hits;
+		physx::PxRigidActor **touches;
+		physx::PxU32 *counts;
+		physx::PxU32 maxTouches;
+	};
+}
+
+void World::prepareBatchQueries()
+{
+	// parallelFor runs at most one chunk per worker plus the calling thread
+	size_t n = cpuDispatcher ? cpuDispatcher->getWorkerCount() + 1 : 1;
+	
+	if (batchQueries.size() < n)
+		batchQueries.resize(n);
+	
+	for (size_t i = 0; i < n; i++)
+	{
+		if (batchQueries[i].query) continue;
+		
+		physx::PxBatchQueryDesc desc(BatchQueryContext::BATCH_SIZE, BatchQueryContext::BATCH_SIZE, BatchQueryContext::BATCH_SIZE);
+		batchQueries[i].query = scene->createBatchQuery(desc);
+		assert(batchQueries[i].query);
+	}
+}
+
+void World::raycasts(const vector<Raycast>& queries, vector<QueryHit>& results)
+{
+	if (results.size() < queries.size())
+		results.resize(queries.size());
+	
+	if (queries.empty()) return;
+	
+	prepareBatchQueries();
+	
+	BatchQueryJob job;
+	job.contexts = &batchQueries;
+	job.raycasts = queries.data();
+	job.hits = results.data();
+	
+	parallelFor(cpuDispatcher, job, queries.size(), BatchQueryContext::BATCH_SIZE);
+}
+
+void World::sweeps(const vector<Sweep>& queries, vector<QueryHit>& results)
+{
+	if (results.size() < queries.size())
+		results.resize(queries.size());
+	
+	if (queries.empty()) return;
+	
+	prepareBatchQueries();
+	
+	BatchQueryJob job;
+	job.contexts = &batchQueries;
+	job.sweeps = queries.data();
+	job.hits = results.data();
+	
+	parallelFor(cpuDispatcher, job, queries.size(), BatchQueryContext::BATCH_SIZE);
+}
+
+void World::overlaps(const vector<Overlap>& queries, vector<physx::PxRigidActor*>& touches, vector<physx::PxU32>& counts, physx::PxU32 maxTouchesPerQuery)
+{
+	if (touches.size() < queries.size() * maxTouchesPerQuery)
+		touches.resize(queries.size() * maxTouchesPerQuery);
+	
+	if (counts.size() < queries.size())
+		counts.resize(queries.size());
+	
+	if (queries.empty() || maxTouchesPerQuery == 0) return;
+	
+	prepareBatchQueries();
+	
+	BatchQueryJob job;
+	job.contexts = &batchQueries;
+	job.overlaps = queries.data();
+	job.touches = touches.data();
+	job.counts = counts.data();
+	job.maxTouches = maxTouchesPerQuery;
+	
+	parallelFor(cpuDispatcher, job, queries.size(), BatchQueryContext::BATCH_SIZE);
 }
 
 OFX_PHYSX_END_NAMESPACE
\ No newline at end of file
@@ -3,12 +3,27 @@
 #include "ofxPhysXConstants.h"
 #include "ofxPhysXHelper.h"
 #include "ofxPhysXWorldScale.h"
+#include "ofxPhysXPoseCache.h"
+#include "ofxPhysXDebugRenderer.h"
+#include "ofxPhysXShapeRenderer.h"
+#include "ofxPhysXForceField.h"
+#include "ofxPhysXTaskScheduler.h"
+#include "ofxPhysXAllocator.h"
+#include "ofxPhysXSceneQuery.h"
+#include "ofxPhysXEvents.h"
+#include "ofxPhysXStats.h"
+#include "ofxPhysXSnapshot.h"
+#include "ofxPhysXCheckpoint.h"
+#include "ofxPhysXMeshCooker.h"
+#include "ofxPhysXSdk.h"
 
 #define NDEBUG
 #include "PxPhysicsAPI.h"
 
 OFX_PHYSX_BEGIN_NAMESPACE
 
+class CompoundBuilder;
+
 class World
 {
 public:
@@ -16,38 +31,383 @@ public:
 	World();
 	virtual ~World();
 	
-	bool setup(const ofVec3f& gravity = ofVec3f(0, -980, 0));
+	bool setup(const ofVec3f& gravity = ofVec3f(0, -980, 0), const TaskSchedulerSettings& settings = TaskSchedulerSettings());
+	
+	// run on a scheduler shared with the app or other Worlds, not owned by the World
+	bool setup(const ofVec3f& gravity, TaskScheduler *scheduler);
+	
+	// NULL when setup with TaskSchedulerSettings::workStealing = false
+	inline TaskScheduler* getTaskScheduler() const { return taskScheduler; }
+	inline physx::PxCpuDispatcher* getCpuDispatcher() const { return cpuDispatcher; }
+	
+	// shared with every other World, NULL before setup()
+	inline Sdk* getSdk() const { return sdk; }
+	inline physx::PxPhysics* getPhysics() const { return physics; }
+	inline physx::PxScene* getScene() const { return scene; }
+	inline physx::PxMaterial* getDefaultMaterial() const { return defaultMaterial; }
+	
 	void update();
 	void draw();
 	
-	physx::PxActor* addBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1);
-	physx::PxActor* addSphere(const float size, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1);
-	physx::PxActor* addCapsule(const float radius, const float height, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1);
-	physx::PxActor* addPlane(const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 0);
+	// advance exactly one step of dt regardless of the frame time, for offline runs
+	void step(float dt);
+	
+	// draw every box, sphere, capsule and plane with one instanced call per group
+	void drawShapes();
+	inline ShapeRenderer& getShapeRenderer() { return shapeRenderer; }
+	
+	// disabling skips generating, copying and drawing the PhysX debug geometry
+	void setDebugDrawEnabled(bool yn);
+	inline bool isDebugDrawEnabled() const { return debugDraw; }
+	
+	// rolling per phase timings and PxSimulationStatistics counts, see WorldStats
+	void setStatsEnabled(bool yn);
+	inline bool isStatsEnabled() const { return statsEnabled; }
+	inline WorldStats& getStats() { return stats; }
+	inline const WorldStats& getStats() const { return stats; }
+	inline void drawStats(float x = 10, float y = 20) const { stats.draw(x, y); }
+	
+	// shared by every World through the PhysX foundation
+	static Allocator& getAllocator();
+	
+	// PhysX allocation names and outstanding allocation tracking, set before the
+	// setup() of the first World, the SDK is created once for all of them
+	void setAllocationTracking(bool yn);
+	inline bool isAllocationTracking() const { return allocationTracking; }
+	
+	// scratch block reused by every simulate(), 0 lets PhysX allocate
+	void setScratchMemorySize(size_t bytes);
+	inline size_t getScratchMemorySize() const { return scratchSize; }
+	
+	// step <= 0 uses the variable frame time (default)
+	void setFixedTimestep(float step, int maxSubSteps = 4);
+	inline float getFixedTimestep() const { return fixedTimestep; }
+	inline int getMaxSubSteps() const { return maxSubSteps; }
+	
+	// 0..1 between the last two fixed steps
+	inline float getInterpolationAlpha() const { return interpolationAlpha; }
+	ofMatrix4x4 getInterpolatedTransform(const physx::PxRigidActor *actor) const;
+	
+	// poses of every actor by slot, refreshed from the active transforms after each step
+	inline const PoseCache& getPoses() const { return poses; }
+	
+	// Pipelined mode starts the last step at the end of update() and collects it
+	// at the start of the next update(), so draw() and app code overlap the solver.
+	// While isSimulating():
+	//  - reading poses (getPoses(), RigidActor_ getters), velocities and drawing
+	//    is legal and returns the previous step's state
+	//  - forces, impulses, velocities and kinematic targets are buffered and legal
+	//  - added actors are queued and join the scene once the step is collected;
+	//    until then their handles, poses, wrapper getters and World kinematic
+	//    targets work and removing them takes them out of the queue, but PhysX
+	//    refuses forces, torques and wake ups: RigidBody skips those with a
+	//    warning, RigidBodyGroup skips the queued bodies
+	//  - resizing shapes, setGravity and clear() are not legal; World methods doing
+	//    those call waitForSimulation() themselves, code touching the PxScene
+	//    directly must call it first
+	void setPipelined(bool yn);
+	inline bool isPipelined() const { return pipelined; }
+	inline bool isSimulating() const { return simulating; }
+	void waitForSimulation();
+	
+	physx::PxActor* addBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addSphere(const float size, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addCapsule(const float radius, const float height, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addPlane(const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 0, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
 	physx::PxActor* addWorldBox(const ofVec3f &leftBottomFar, const ofVec3f& rightTopNear);
 	
+	// Convex hulls of the mesh vertices are dynamic unless density is 0. Triangle
+	// meshes are always static. Both are cooked through getMeshCooker(); the
+	// overloads taking a PhysX mesh add the result of MeshCooker::cookAsync().
+	physx::PxActor* addConvexMesh(const ofMesh& mesh, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addConvexMesh(physx::PxConvexMesh *mesh, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), float density = 1, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addTriangleMesh(const ofMesh& mesh, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addTriangleMesh(physx::PxTriangleMesh *mesh, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	
+	inline MeshCooker& getMeshCooker() { return meshCooker; }
+	
+	// instances of a built CompoundBuilder, sharing its shapes and mass properties
+	physx::PxActor* addCompound(const CompoundBuilder& compound, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion());
+	vector<physx::PxActor*> addCompounds(const CompoundBuilder& compound, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations = vector<ofQuaternion>(), bool aggregate = false);
+	
+	// Static terrain from the first channel of the pixels: image x runs along world
+	// x, image y along world z. scale.x and scale.z are the sample spacing, a float
+	// sample of 1 or a short sample of 65535 is scale.y high. Samples are stored
+	// as 16 bit, float samples are clamped to [-1, 1].
+	physx::PxActor* addHeightField(const ofFloatPixels& pixels, const ofVec3f& scale, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addHeightField(const ofShortPixels& pixels, const ofVec3f& scale, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	
+	// rewrite the samples under the pixels in place, (x, y) is their top left sample
+	bool modifyHeightField(physx::PxRigidActor *actor, const ofFloatPixels& pixels, int x, int y);
+	bool modifyHeightField(physx::PxRigidActor *actor, const ofShortPixels& pixels, int x, int y);
+	
+	static const physx::PxI16 MAX_HEIGHT_SAMPLE = 32767;
+	
+	// Bulk creation: sizes and rotations hold either one entry for all bodies or
+	// one per position. Identical geometry shares one PxShape, mass properties are
+	// computed once per shape and the batch goes in with a single addActors, or in
+	// PxAggregates of up to MAX_AGGREGATE_SIZE actors when aggregate is set.
+	vector<physx::PxActor*> addBoxes(const vector<ofVec3f>& sizes, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations = vector<ofQuaternion>(), float density = 1, bool aggregate = false, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	vector<physx::PxActor*> addSpheres(const vector<float>& sizes, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations = vector<ofQuaternion>(), float density = 1, bool aggregate = false, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	vector<physx::PxActor*> addCapsules(const vector<float>& radii, const vector<float>& heights, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations = vector<ofQuaternion>(), float density = 1, bool aggregate = false, physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	
+	static const physx::PxU32 MAX_AGGREGATE_SIZE = 128;
+	
+	// Removed actors leave the pose cache at once and the scene in one batch at
+	// the next sync point: the start or end of a step, or waitForSimulation().
+	// Dynamic actors go to a pool reused by the next adds, reset to the state of
+	// a new actor; settings made directly on the PhysX actor may carry over.
 	void removeActor(physx::PxActor *actor);
+	void setActorPoolSize(size_t n);
+	inline size_t getActorPoolSize() const { return actorPoolSize; }
+	
+	// Generation checked handles, see PoseCache. Handles of removed actors are
+	// skipped by removeActors(), which returns how many were removed.
+	inline PoseCache::Handle getHandle(const physx::PxActor *actor) const { return PoseCache::getHandle(actor); }
+	
+	// the World an actor was added to, also while it is queued for the scene
+	static inline World* getWorld(const physx::PxActor *actor) { return (World*)PoseCache::getOwner(actor); }
+	inline physx::PxRigidActor* getActor(PoseCache::Handle handle) const { return poses.resolve(handle); }
+	size_t removeActors(const vector<PoseCache::Handle>& handles);
+	
+	// All actors, shapes and materials with their dynamic state as a PhysX binary
+	// collection. Loading maps the file and deserializes it in place, adding the
+	// actors to this World; the mapping is held until clear().
+	bool saveSnapshot(const string& path);
+	bool loadSnapshot(const string& path);
+	
+	// Pose, velocities and sleep state of every dynamic body. restore() writes
+	// them back to the bodies that still exist and returns how many; bodies added
+	// since are left alone. The overloads without a Checkpoint use an internal one.
+	void checkpoint(Checkpoint& cp);
+	size_t restore(const Checkpoint& cp);
+	inline void checkpoint() { checkpoint(defaultCheckpoint); }
+	inline size_t restore() { return restore(defaultCheckpoint); }
+	
+	// Sizes as reported by RigidActor_::getSize(): box extents, sphere radius in x,
+	// capsule radius and full height in x and y, mesh scale, height field scale.
+	// Dynamic bodies keep their density, their mass and inertia are recomputed
+	// for the new primitive; sleeping bodies touching the old or new shape are
+	// woken. setSizes() takes one size for all or one per handle and returns how
+	// many actors were resized.
+	void setSize(physx::PxRigidActor *actor, const ofVec3f& size);
+	size_t setSizes(const vector<PoseCache::Handle>& handles, const vector<ofVec3f>& sizes);
+	
+	// Kinematic bodies follow their pose instead of the solver. A shape that keeps
+	// changing size is cheaper on a kinematic body than on a static, which rebuilds
+	// the static scene structures. A static actor is replaced by a kinematic body
+	// with copies of its shapes, so its handle and pointer become invalid.
+	physx::PxRigidDynamic* setKinematic(physx::PxRigidActor *actor, bool yn = true);
+	
+	physx::PxActor* addKinematicBox(const ofVec3f& size, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addKinematicSphere(const float size, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxActor* addKinematicCapsule(const float radius, const float height, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion(), physx::PxU32 group = DEFAULT_GROUP, physx::PxU32 mask = ALL_GROUPS);
+	
+	// Kinematic targets can be staged from any thread, e.g. one reading a tracking
+	// system. They are collected behind a short lock and applied in one pass before
+	// the next simulate(), so the producer never waits for a step. The last target
+	// staged for a body wins, targets for removed or non-kinematic bodies are dropped.
+	void setKinematicTarget(PoseCache::Handle handle, const ofVec3f& pos, const ofQuaternion& rot = ofQuaternion());
+	void setKinematicTargets(const PoseCache::Handle *handles, const physx::PxTransform *targets, size_t count);
+	inline void setKinematicTargets(const vector<PoseCache::Handle>& handles, const vector<physx::PxTransform>& targets)
+	{
+		assert(handles.size() == targets.size());
+		if (!handles.empty()) setKinematicTargets(&handles[0], &targets[0], min(handles.size(), targets.size()));
+	}
+	
+	// call after attaching, detaching or changing shapes of an actor directly,
+	// refreshes the cached shape and the shape renderer
+	void invalidateShapes(physx::PxRigidActor *actor);
 	
 	void setGravity(ofVec3f gravity);
 	
+	// evaluated over the moving, non-kinematic bodies before every step, see
+	// ForceFieldSystem::apply()
+	inline size_t addForceField(const ForceField& field) { return forceFields.add(field); }
+	inline void removeForceField(size_t id) { forceFields.remove(id); }
+	inline ForceField& getForceField(size_t id) { return forceFields.get(id); }
+	inline ForceFieldSystem& getForceFields() { return forceFields; }
+	
+	// An actor belongs to the groups in its group bits and collides with actors
+	// whose group has any bit of its mask, checked both ways in the filter shader.
+	// Group bits are also matched against force field and scene query masks.
+	static const physx::PxU32 DEFAULT_GROUP = 1;
+	static const physx::PxU32 ALL_GROUPS = 0xffffffff;
+	void setGroup(physx::PxRigidActor *actor, physx::PxU32 group, physx::PxU32 mask = ALL_GROUPS);
+	physx::PxU32 getGroup(const physx::PxRigidActor *actor) const;
+	
+	// pairs rejected by the masks are killed, unless one side is in these groups:
+	// then they're suppressed and come back cheaply when the groups change
+	void setSuppressedGroups(physx::PxU32 groups);
+	inline physx::PxU32 getSuppressedGroups() const { return filterSettings.suppressedGroups; }
+	
+	// Contact, trigger, sleep and wake events are pushed into getEvents() while
+	// fetching results. With a force threshold on a dynamic actor, PhysX reports
+	// its contacts only while their total normal force exceeds it, so weaker pairs
+	// never have their contact points extracted.
+	void setEventReporting(physx::PxRigidActor *actor, physx::PxU32 report = Event::REPORT_CONTACTS, float forceThreshold = 0);
+	void setTrigger(physx::PxRigidActor *actor, bool yn = true);
+	
+	// drain from one consumer thread
+	inline EventQueue& getEvents() { return events; }
+	
+	// detach a shared shape and give the actor its own copy
+	static physx::PxShape* makeExclusive(physx::PxRigidActor *actor, physx::PxShape *shape);
+	
+	// only the geometry, see setSize()
+	static bool setGeometrySize(physx::PxShape *shape, const ofVec3f& size);
+	
+	// scene queries, legal while a pipelined step is in flight; raycasts and
+	// sweeps with a zero length direction report no hit
+	bool raycast(const ofVec3f& origin, const ofVec3f& direction, float distance, QueryHit& hit, physx::PxU32 mask = 0xffffffff) const;
+	bool raycast(const Raycast& query, QueryHit& hit) const;
+	bool sweep(const Sweep& query, QueryHit& hit) const;
+	size_t overlap(const Overlap& query, vector<physx::PxRigidActor*>& result, physx::PxU32 maxTouches = 256) const;
+	
+	// batched forms split the queries into PxBatchQuery runs on the dispatcher
+	// threads, results are written into the given buffers which are only resized
+	// when too small; overlap touches for query i start at i * maxTouchesPerQuery
+	void raycasts(const vector<Raycast>& queries, vector<QueryHit>& results);
+	void sweeps(const vector<Sweep>& queries, vector<QueryHit>& results);
+	void overlaps(const vector<Overlap>& queries, vector<physx::PxRigidActor*>& touches, vector<physx::PxU32>& counts, physx::PxU32 maxTouchesPerQuery = 16);
+	
+	// releases the scene and the renderers' GL buffers, so it needs the GL context
 	void clear();
 	
+	// clear() and free the remaining GL resources, call from ofApp::exit() while
+	// the context is alive; the destructor only releases the PhysX objects
+	void exit();
+	
 protected:
 	
-	physx::PxRigidActor* createRigid(const ofVec3f& pos, const ofQuaternion& rot, float density);
+	void releaseScene();
+	
+	bool setup(const ofVec3f& gravity, const TaskSchedulerSettings& settings, TaskScheduler *scheduler);
+	
+	physx::PxRigidActor* createRigid(const ofVec3f& pos, const ofQuaternion& rot, float density, bool kinematic = false);
+	physx::PxRigidActor* createRigidActor(const ofVec3f& pos, const ofQuaternion& rot, float density, bool kinematic = false);
 	physx::PxRigidActor* updateMassAndInertia(physx::PxRigidActor *rigid, float density);
 	
+	physx::PxActor* addHeightField(const vector<physx::PxHeightFieldSample>& samples, int width, int height, const ofVec3f& scale, const ofVec3f& pos, const ofQuaternion& rot, physx::PxU32 group, physx::PxU32 mask);
+	bool modifyHeightField(physx::PxRigidActor *actor, const vector<physx::PxHeightFieldSample>& samples, int width, int height, int x, int y);
+	
+	physx::PxShape* getSharedShape(const physx::PxGeometry& geometry, physx::PxU32 group, physx::PxU32 mask);
+	vector<physx::PxActor*> addRigids(const vector<physx::PxShape*>& shapes, const vector<ofVec3f>& positions, const vector<ofQuaternion>& rotations, float density, bool aggregate, physx::PxU32 group);
+	void insertActors(vector<physx::PxActor*>& actors, bool aggregate, physx::PxU32 group);
+	physx::PxRigidActor* createCompoundActor(const CompoundBuilder& compound, const ofVec3f& pos, const ofQuaternion& rot);
+	
+	void prepareBatchQueries();
+	void wakeTouching(const vector<physx::PxBounds3>& bounds);
+	
+	// substeps due for a frame of t seconds, updates the accumulator and alpha
+	int advance(float t, float& dt);
+	static float getFrameTime();
+	
+	friend class WorldGroup;
+	void beginStep(float dt);
+	
+	// remaining is the number of substeps of this frame still to come: poses are
+	// copied for the last two only, the debug buffer for the last one
+	void endStep(int remaining = 0);
+	void flushPendingActors();
+	void dropActor(physx::PxActor *actor);
+	void recycleActor(physx::PxActor *actor);
+	void applyKinematicTargets();
+	
 protected:
 	
+	Sdk *sdk;
 	physx::PxFoundation *foundation;
-	physx::PxProfileZoneManager *profileZoneManager;
 	physx::PxPhysics *physics;
-	physx::PxDefaultCpuDispatcher *cpuDispatcher;
+	physx::PxCpuDispatcher *cpuDispatcher;
+	physx::PxDefaultCpuDispatcher *defaultDispatcher;
+	TaskScheduler *taskScheduler;
+	bool ownsTaskScheduler;
 	
 	physx::PxScene *scene;
 	physx::PxMaterial *defaultMaterial;
 	
-	physx::PxCudaContextManager* cudaContextManager;
+	float fixedTimestep;
+	int maxSubSteps;
+	float accumulator;
+	float interpolationAlpha;
+	
+	bool pipelined;
+	bool simulating;
+	
+	bool debugDraw;
+	DebugRenderer debugRenderer;
+	ShapeRenderer shapeRenderer;
+	
+	bool statsEnabled;
+	WorldStats stats;
+	inline WorldStats* profiling() { return statsEnabled ? &stats : NULL; }
+	
+	bool allocationTracking;
+	void *scratchBlock;
+	size_t scratchSize;
+	
+	PoseCache poses;
+	ForceFieldSystem forceFields;
+	
+	struct KinematicTarget
+	{
+		PoseCache::Handle handle;
+		physx::PxTransform pose;
+	};
+	
+	// staged by any thread, swapped with applied at the start of a step
+	Poco::FastMutex targetMutex;
+	vector<KinematicTarget> stagedTargets;
+	vector<KinematicTarget> appliedTargets;
+	
+	MeshCooker meshCooker;
+	
+	struct ShapeKey
+	{
+		physx::PxGeometryType::Enum type;
+		float a, b, c;
+		physx::PxU32 group, mask;
+		
+		inline bool operator<(const ShapeKey& o) const
+		{
+			if (type != o.type) return type < o.type;
+			if (group != o.group) return group < o.group;
+			if (mask != o.mask) return mask < o.mask;
+			if (a != o.a) return a < o.a;
+			if (b != o.b) return b < o.b;
+			return c < o.c;
+		}
+	};
+	
+	// queued by the add and remove calls, see flushPendingActors()
+	vector<physx::PxActor*> pendingAdds;
+	vector<physx::PxAggregate*> pendingAggregates;
+	vector<physx::PxActor*> pendingRemovals;
+	
+	vector<physx::PxRigidDynamic*> actorPool;
+	size_t actorPoolSize;
+	
+	map<ShapeKey, physx::PxShape*> sharedShapes;
+	vector<physx::PxAggregate*> aggregates;
+	vector<MappedFile*> snapshots;
+	
+	friend class CompoundBuilder;
+	set<CompoundBuilder*> compounds;
+	Checkpoint defaultCheckpoint;
+	
+	struct FilterSettings
+	{
+		physx::PxU32 suppressedGroups;
+	};
+	
+	FilterSettings filterSettings;
+	
+	EventQueue events;
+	SimulationEventCallback eventCallback;
+	
+	vector<BatchQueryContext> batchQueries;
+	vector<physx::PxBounds3> resizedBounds;
 };
 
 OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,82 @@
+#include "ofxPhysXWorldGroup.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+void WorldGroup::add(World& world)
+{
+	if (find(worlds.begin(), worlds.end(), &world) == worlds.end())
+		worlds.push_back(&world);
+}
+
+void WorldGroup::remove(World& world)
+{
+	vector<World*>::iterator it = find(worlds.begin(), worlds.end(), &world);
+	if (it != worlds.end())
+		worlds.erase(it);
+}
+
+void WorldGroup::update()
+{
+	const float t = World::getFrameTime();
+	
+	numSteps.resize(worlds.size());
+	timesteps.resize(worlds.size());
+	
+	int n = 0;
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		World *world = worlds[i];
+		
+		if (!world->physics)
+		{
+			ofLogError("ofxPhysX::WorldGroup") << "world " << i << " is not setup";
+			numSteps[i] = 0;
+			continue;
+		}
+		
+		// collect the steps started at the end of the last update
+		world->endStep();
+		
+		numSteps[i] = world->advance(t, timesteps[i]);
+		n = max(n, numSteps[i]);
+	}
+	
+	for (int k = 0; k < n; k++)
+	{
+		for (size_t i = 0; i < worlds.size(); i++)
+		{
+			if (k < numSteps[i])
+				worlds[i]->beginStep(timesteps[i]);
+		}
+		
+		// the first fetch waits while the other scenes keep solving
+		for (size_t i = 0; i < worlds.size(); i++)
+		{
+			if (k < numSteps[i] && (!worlds[i]->pipelined || k < numSteps[i] - 1))
+				worlds[i]->endStep(numSteps[i] - 1 - k);
+		}
+	}
+}
+
+void WorldGroup::step(float dt)
+{
+	for (size_t i = 0; i < worlds.size(); i++)
+	{
+		World *world = worlds[i];
+		if (!world->physics) continue;
+		
+		world->endStep();
+		world->interpolationAlpha = 1;
+		world->beginStep(dt);
+	}
+	
+	waitForSimulation();
+}
+
+void WorldGroup::waitForSimulation()
+{
+	for (size_t i = 0; i < worlds.size(); i++)
+		worlds[i]->endStep();
+}
+
+OFX_PHYSX_END_NAMESPACE
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ofxPhysXConstants.h"
+#include "ofxPhysXWorld.h"
+
+OFX_PHYSX_BEGIN_NAMESPACE
+
+// Steps several independent Worlds together: every scene is started before any
+// is collected, so their solver tasks run side by side on the dispatcher threads
+// instead of one scene after the other. Set the Worlds up on one shared
+// TaskScheduler so they don't oversubscribe the cores. The Worlds are not owned.
+class WorldGroup
+{
+public:
+	
+	WorldGroup() {}
+	
+	void add(World& world);
+	void remove(World& world);
+	inline void clear() { worlds.clear(); }
+	
+	inline size_t size() const { return worlds.size(); }
+	inline bool empty() const { return worlds.empty(); }
+	inline World& operator[](size_t i) const { return *worlds[i]; }
+	
+	// same as World::update() on each World, with their own fixed timesteps and
+	// pipelined settings
+	void update();
+	
+	// one step of dt on each World
+	void step(float dt);
+	
+	void waitForSimulation();
+	
+protected:
+	
+	vector<World*> worlds;
+	
+	// scratch, kept to avoid reallocating every frame
+	vector<int> numSteps;
+	vector<float> timesteps;
+};
+
+OFX_PHYSX_END_NAMESPACE